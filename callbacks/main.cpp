@@ -1,5 +1,183 @@
 #include <iostream>
 #include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <atomic>
+#include <new>
+#include <string_view>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <sstream>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "../common/allocation_counting.h"
+
+namespace simdLetterShift {
+    // The encryptors below add a number to every letter of the message, one byte at a time,
+    // with four range checks per byte. For messages of megabytes this is done on 16 (SSE2) or
+    // 32 (AVX2) bytes at once: a mask marks the letters and the shift is added only where the mask is set.
+    // The best kernel for the CPU is chosen once at runtime, the scalar one is the reference.
+
+    // Adds 'delta' to every ASCII letter, wrapping around like char arithmetic does
+    void shiftLettersScalar(char * data, size_t size, int delta)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            if ((data[i] >= 'a' && data[i] <= 'z') || (data[i] >= 'A' && data[i] <= 'Z'))
+                data[i] = static_cast<char>(data[i] + delta);
+        }
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    // c | 0x20 turns 'A'..'Z' into 'a'..'z' and no other byte into a lower case letter,
+    // so one signed range check finds all letters. Bytes >= 0x80 are negative and never match.
+    __attribute__((target("sse2")))
+    void shiftLettersSse2(char * data, size_t size, int delta)
+    {
+        const __m128i caseBit = _mm_set1_epi8(0x20);
+        const __m128i beforeA = _mm_set1_epi8('a' - 1);
+        const __m128i afterZ = _mm_set1_epi8('z' + 1);
+        const __m128i shift = _mm_set1_epi8(static_cast<char>(delta));
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16)
+        {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            __m128i lower = _mm_or_si128(bytes, caseBit);
+            __m128i isLetter = _mm_and_si128(_mm_cmpgt_epi8(lower, beforeA), _mm_cmpgt_epi8(afterZ, lower));
+            bytes = _mm_add_epi8(bytes, _mm_and_si128(isLetter, shift));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(data + i), bytes);
+        }
+        shiftLettersScalar(data + i, size - i, delta);
+    }
+
+    __attribute__((target("avx2")))
+    void shiftLettersAvx2(char * data, size_t size, int delta)
+    {
+        const __m256i caseBit = _mm256_set1_epi8(0x20);
+        const __m256i beforeA = _mm256_set1_epi8('a' - 1);
+        const __m256i afterZ = _mm256_set1_epi8('z' + 1);
+        const __m256i shift = _mm256_set1_epi8(static_cast<char>(delta));
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32)
+        {
+            __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            __m256i lower = _mm256_or_si256(bytes, caseBit);
+            __m256i isLetter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, beforeA), _mm256_cmpgt_epi8(afterZ, lower));
+            bytes = _mm256_add_epi8(bytes, _mm256_and_si256(isLetter, shift));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(data + i), bytes);
+        }
+        shiftLettersSse2(data + i, size - i, delta);
+    }
+#endif
+
+    typedef void(*ShiftKernel)(char *, size_t, int);
+
+    struct Kernel {
+        const char * name;
+        ShiftKernel function;
+    };
+
+    // All kernels this CPU can run, the best one last
+    std::vector<Kernel> availableKernels()
+    {
+        std::vector<Kernel> kernels = { { "scalar", &shiftLettersScalar } };
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse2"))
+            kernels.push_back({ "sse2", &shiftLettersSse2 });
+        if (__builtin_cpu_supports("avx2"))
+            kernels.push_back({ "avx2", &shiftLettersAvx2 });
+#endif
+        return kernels;
+    }
+
+    const Kernel & bestKernel()
+    {
+        static const Kernel kernel = availableKernels().back();
+        return kernel;
+    }
+
+    void shiftLetters(char * data, size_t size, int delta)
+    {
+        bestKernel().function(data, size, delta);
+    }
+
+    // Every kernel must give exactly the scalar result, for all byte values,
+    // lengths around the vector widths, unaligned starts and all kinds of shifts
+    bool propertyTest()
+    {
+        std::mt19937 random(42);
+        std::uniform_int_distribution<int> byte(0, 255);
+        std::uniform_int_distribution<int> length(0, 200);
+        const int deltas[] = { 1, 2, -1, 25, -26, 127, 200, -300, 0 };
+        std::vector<Kernel> kernels = availableKernels();
+        bool passed = true;
+
+        for (int round = 0; round < 10000 && passed; ++round)
+        {
+            std::string input(length(random), '\0');
+            for (auto & c : input)
+                c = static_cast<char>(round % 2 ? byte(random) : "aAzZ@[`{ 09"[byte(random) % 11]);
+            int delta = deltas[round % (sizeof(deltas) / sizeof(deltas[0]))];
+            size_t offset = input.empty() ? 0 : round % std::min<size_t>(input.size(), 7);
+
+            std::string expected = input;
+            shiftLettersScalar(&expected[offset], expected.size() - offset, delta);
+            for (const Kernel & kernel : kernels)
+            {
+                std::string actual = input;
+                kernel.function(&actual[offset], actual.size() - offset, delta);
+                if (actual != expected)
+                {
+                    std::cout << "Error : " << kernel.name << " differs from scalar, length " << input.size()
+                              << " offset " << offset << " delta " << delta << std::endl;
+                    passed = false;
+                }
+            }
+        }
+        std::cout << "property test of " << kernels.size() << " kernels against scalar -> " << (passed ? "PASSED" : "FAILED") << std::endl;
+        return passed;
+    }
+
+    void benchmark()
+    {
+        const size_t size = 16 * 1024 * 1024;
+        std::string text(size, '\0');
+        std::mt19937 random(1);
+        std::uniform_int_distribution<int> byte(32, 126);
+        for (auto & c : text)
+            c = static_cast<char>(byte(random));
+
+        for (const Kernel & kernel : availableKernels())
+        {
+            const int rounds = 20;
+            auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < rounds; ++r)
+                kernel.function(&text[0], text.size(), r % 2 ? -1 : 1);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << kernel.name << " : " << size * rounds / seconds / 1e9 << " GB/s" << std::endl;
+        }
+        std::cout << "dispatch picks " << bestKernel().name << std::endl;
+    }
+}
 
 namespace functionPointers {
     // Now what is a callback?
@@ -26,11 +204,8 @@ namespace functionPointers {
     //This encrypt function increment all letters in string by 1.
     std::string encryptDataByLetterInc(std::string data)
     {
-        for (int i = 0; i < data.size(); i++)
-        {
-            if ((data[i] >= 'a' && data[i] <= 'z') || (data[i] >= 'A' && data[i] <= 'Z'))
-                data[i]++;
-        }
+        // Same as incrementing every letter in a loop, 16 / 32 letters at a time
+        simdLetterShift::shiftLetters(&data[0], data.size(), 1);
         return data;
     }
 
@@ -100,15 +275,13 @@ namespace functionObjectsAndFunctors {
             m_count = count;
         }
         std::string operator()(std::string data) {
-            for (int i = 0; i < data.size(); i++)
-                if ((data[i] >= 'a' && data[i] <= 'z')
-                    || (data[i] >= 'A' && data[i] <= 'Z'))
-                    if (m_isIncremental)
-                        data[i] = data[i] + m_count;
-                    else
-                        data[i] = data[i] - m_count;
+            (*this)(&data[0], data.size());
             return data;
         }
+        // Encrypts the data where it is, without copying it
+        void operator()(char * data, size_t size) const {
+            simdLetterShift::shiftLetters(data, size, m_isIncremental ? m_count : -m_count);
+        }
 
     };
 
@@ -141,8 +314,1294 @@ namespace functionObjectsAndFunctors {
     }
 }
 
-int main()
+namespace zeroCopyMessages {
+    // The buildCompleteMessage functions above take the data by value, glue header, data and footer together
+    // through temporary strings, pass the result by value to the encryptor and get another copy back.
+    // Here the message is written once into a buffer of the caller, and the encryptor works on that buffer.
+    // A buffer that is reused for every message doesn't need any heap allocation once it is big enough.
+    const std::string_view header = "[HEADER]";
+    const std::string_view footer = "[FooTER]";
+
+    size_t completeMessageSize(std::string_view rawData)
+    {
+        return header.size() + rawData.size() + footer.size();
+    }
+
+    // An encryptor that works in place : void(char * data, size_t size)
+    void encryptDataByLetterInc(char * data, size_t size)
+    {
+        simdLetterShift::shiftLetters(data, size, 1);
+    }
+
+    // Writes the message into buffer[0, capacity), returns it, or an empty view if it doesn't fit
+    template <typename InPlaceEncryptor>
+    std::string_view buildCompleteMessage(std::string_view rawData, char * buffer, size_t capacity, InPlaceEncryptor encryptor)
+    {
+        size_t size = completeMessageSize(rawData);
+        if (size > capacity)
+            return std::string_view();
+        std::memcpy(buffer, header.data(), header.size());
+        std::memcpy(buffer + header.size(), rawData.data(), rawData.size());
+        std::memcpy(buffer + header.size() + rawData.size(), footer.data(), footer.size());
+        encryptor(buffer, size);
+        return std::string_view(buffer, size);
+    }
+
+    // Writes the message into 'out', its capacity is reused
+    template <typename InPlaceEncryptor>
+    std::string & buildCompleteMessage(std::string_view rawData, std::string & out, InPlaceEncryptor encryptor)
+    {
+        out.resize(completeMessageSize(rawData));
+        buildCompleteMessage(rawData, &out[0], out.size(), encryptor);
+        return out;
+    }
+
+    void test()
+    {
+        std::string message;
+        std::cout << buildCompleteMessage("SampleString", message, &encryptDataByLetterInc) << std::endl;
+        std::cout << buildCompleteMessage("SampleString", message, functionObjectsAndFunctors::Encryptor(true, 2)) << std::endl;
+
+        char buffer[64];
+        std::cout << buildCompleteMessage("SampleString", buffer, sizeof(buffer), functionObjectsAndFunctors::Encryptor(false, 1)) << std::endl;
+    }
+
+    // Once the reused buffer has grown, building a message must not allocate at all
+    bool allocationTest()
+    {
+        std::string payload(1000, 'x');
+        std::string message;
+        char buffer[2048];
+        functionObjectsAndFunctors::Encryptor encryptor(true, 3);
+
+        buildCompleteMessage(payload, message, encryptor);
+        long long before = allocationCounting::count();
+        for (int i = 0; i < 1000; ++i)
+        {
+            buildCompleteMessage(std::string_view(payload).substr(i % 100), message, encryptor);
+            buildCompleteMessage(std::string_view(payload).substr(i % 100), buffer, sizeof(buffer), &encryptDataByLetterInc);
+        }
+        long long zeroCopy = allocationCounting::count() - before;
+
+        before = allocationCounting::count();
+        for (int i = 0; i < 1000; ++i)
+            functionObjectsAndFunctors::buildCompleteMessage(payload, encryptor);
+        long long byValue = allocationCounting::count() - before;
+
+        bool passed = zeroCopy == 0;
+        std::cout << "allocations per message : by value " << byValue / 1000.0 << ", zero copy " << zeroCopy / 2000.0
+                  << " -> " << (passed ? "PASSED" : "FAILED") << std::endl;
+        return passed;
+    }
+
+    void benchmark()
+    {
+        functionObjectsAndFunctors::Encryptor encryptor(true, 1);
+        for (size_t payloadSize : { 64, 4096 })
+        {
+            std::string payload(payloadSize, 'p');
+            std::string message;
+            const int count = payloadSize < 1000 ? 2000000 : 200000;
+            // Keeps the compiler from dropping the calls
+            volatile size_t sink = 0;
+
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < count; ++i)
+                sink += functionPointers::buildCompleteMessage(payload, &functionPointers::encryptDataByLetterInc).size();
+            auto pointerDone = std::chrono::steady_clock::now();
+            for (int i = 0; i < count; ++i)
+                sink += functionObjectsAndFunctors::buildCompleteMessage(payload, encryptor).size();
+            auto functorDone = std::chrono::steady_clock::now();
+            for (int i = 0; i < count; ++i)
+                sink += buildCompleteMessage(payload, message, encryptor).size();
+            auto zeroCopyDone = std::chrono::steady_clock::now();
+
+            auto rate = [count](std::chrono::steady_clock::duration duration) {
+                return count / std::chrono::duration<double>(duration).count() / 1e6;
+            };
+            std::cout << payloadSize << " byte payload, M messages/s : function pointer " << rate(pointerDone - start)
+                      << ", functor " << rate(functorDone - pointerDone) << ", zero copy " << rate(zeroCopyDone - functorDone) << std::endl;
+        }
+    }
+}
+
+namespace compileTimeTransforms {
+    // A function pointer, a std::function or a virtual function is called through an address that is only
+    // known at runtime, so the compiler can't inline it into the loop over the message, and a functor with
+    // its shift in a member can be inlined but the shift is still a runtime value.
+    // When the callback is a template parameter and its parameters are template arguments,
+    // the compiler sees the whole code with the shift as a constant, and can vectorize the loop.
+
+    // Letters are shifted by Count, up if Inc is true and down otherwise
+    template <bool Inc, int Count>
+    class Encryptor {
+    public:
+        // Branch free, so the loop calling it can be vectorized
+        char operator()(char c) const {
+            unsigned char lower = static_cast<unsigned char>(c | 0x20);
+            bool isLetter = static_cast<unsigned char>(lower - 'a') < 26;
+            return static_cast<char>(c + (isLetter ? (Inc ? Count : -Count) : 0));
+        }
+        void operator()(char * data, size_t size) const {
+            for (size_t i = 0; i < size; i++)
+                data[i] = (*this)(data[i]);
+        }
+    };
+
+    // The same with the shift as a runtime value
+    class RuntimeEncryptor {
+        int m_delta;
+    public:
+        RuntimeEncryptor(bool isInc, int count) : m_delta(isInc ? count : -count) {}
+        char operator()(char c) const {
+            unsigned char lower = static_cast<unsigned char>(c | 0x20);
+            bool isLetter = static_cast<unsigned char>(lower - 'a') < 26;
+            return static_cast<char>(c + (isLetter ? m_delta : 0));
+        }
+    };
+
+    char encryptLetterByInc(char c)
+    {
+        return Encryptor<true, 1>()(c);
+    }
+
+    char encryptLetterByDec(char c)
+    {
+        return Encryptor<false, 1>()(c);
+    }
+
+    class LetterTransform {
+    public:
+        virtual ~LetterTransform() {}
+        virtual char apply(char c) const = 0;
+    };
+
+    template <bool Inc, int Count>
+    class VirtualEncryptor : public LetterTransform {
+    public:
+        char apply(char c) const override { return Encryptor<Inc, Count>()(c); }
+    };
+
+    // Calls transform(c) for every byte of the message, any callable with char(char) will do
+    template <typename Transform>
+    std::string & buildCompleteMessage(std::string_view rawData, std::string & out, Transform transform)
+    {
+        return zeroCopyMessages::buildCompleteMessage(rawData, out, [&transform](char * data, size_t size) {
+            for (size_t i = 0; i < size; i++)
+                data[i] = transform(data[i]);
+        });
+    }
+
+    void test()
+    {
+        std::string message;
+        std::cout << buildCompleteMessage("SampleString", message, Encryptor<true, 1>()) << std::endl;
+        std::cout << buildCompleteMessage("SampleString", message, Encryptor<true, 2>()) << std::endl;
+        std::cout << buildCompleteMessage("SampleString", message, Encryptor<false, 1>()) << std::endl;
+    }
+
+    // The loop every kind of callback is measured with, it is not inlined, like a library function
+    template <typename Transform>
+    __attribute__((noinline)) void transformBytes(char * data, size_t size, Transform transform)
+    {
+        for (size_t i = 0; i < size; i++)
+            data[i] = transform(data[i]);
+    }
+
+    template <typename Run>
+    double nanosecondsPerByte(std::string & text, Run run)
+    {
+        const int rounds = 20;
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; ++r)
+            run(&text[0], text.size());
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (rounds * text.size());
+    }
+
+    // Per byte cost of calling the shift of every byte through the different kinds of callbacks.
+    // Which callback is used is picked at runtime through 'choice', as it would be in a real program,
+    // so the compiler can't find out the target of the pointer or of the virtual call.
+    void benchmark()
+    {
+        std::string text(4 * 1024 * 1024, '\0');
+        std::mt19937 random(1);
+        std::uniform_int_distribution<int> byte(32, 126);
+        for (auto & c : text)
+            c = static_cast<char>(byte(random));
+
+        volatile int choice = 0;
+        char(*const pointers[])(char) = { &encryptLetterByInc, &encryptLetterByDec };
+        const VirtualEncryptor<true, 1> virtualInc;
+        const VirtualEncryptor<false, 1> virtualDec;
+        const LetterTransform * transforms[] = { &virtualInc, &virtualDec };
+
+        char(*pointer)(char) = pointers[choice];
+        RuntimeEncryptor runtimeEncryptor(choice == 0, 1);
+        std::function<char(char)> function = runtimeEncryptor;
+        const LetterTransform * transform = transforms[choice];
+
+        std::cout << "ns per byte (GB/s) :" << std::endl;
+        auto report = [](const char * name, double ns) {
+            std::cout << "  " << name << " : " << ns << " (" << 1.0 / ns << ")" << std::endl;
+        };
+        report("function pointer      ", nanosecondsPerByte(text, [&](char * data, size_t size) {
+            transformBytes(data, size, pointer);
+        }));
+        report("runtime functor       ", nanosecondsPerByte(text, [&](char * data, size_t size) {
+            transformBytes(data, size, runtimeEncryptor);
+        }));
+        report("compile time functor  ", nanosecondsPerByte(text, [&](char * data, size_t size) {
+            transformBytes(data, size, Encryptor<true, 1>());
+        }));
+        report("std::function         ", nanosecondsPerByte(text, [&](char * data, size_t size) {
+            transformBytes(data, size, std::ref(function));
+        }));
+        report("virtual interface     ", nanosecondsPerByte(text, [&](char * data, size_t size) {
+            transformBytes(data, size, [transform](char c) { return transform->apply(c); });
+        }));
+    }
+}
+
+namespace batchMessages {
+    // Building one message at a time allocates a few strings for each of them, and the result of each is
+    // a string of its own. A batch writes all messages one after the other into a single buffer (the arena)
+    // and remembers where each one starts, the messages are handed out as views into the arena.
+    // The arena and the index keep their capacity, so a batch that is reused doesn't allocate at all
+    // once it has seen its biggest batch. The encryptor is called once for the whole arena,
+    // so it must work byte by byte, like all the encryptors here.
+    class MessageBatch
+    {
+        std::string m_arena;
+        std::vector<size_t> m_offsets;      // message i is [m_offsets[i], m_offsets[i + 1]) of the arena
+    public:
+        MessageBatch() : m_offsets(1, 0) {}
+
+        size_t size() const
+        {
+            return m_offsets.size() - 1;
+        }
+
+        std::string_view operator[](size_t index) const
+        {
+            return std::string_view(m_arena.data() + m_offsets[index], m_offsets[index + 1] - m_offsets[index]);
+        }
+
+        // Bytes of all messages together
+        size_t bytes() const
+        {
+            return m_arena.size();
+        }
+
+        // Replaces the messages by the complete messages of the payloads, which is any container
+        // of something that converts to a std::string_view (std::string, const char *, ...)
+        template <typename Payloads, typename InPlaceEncryptor>
+        MessageBatch & build(const Payloads & payloads, InPlaceEncryptor encryptor)
+        {
+            const std::string_view header = zeroCopyMessages::header;
+            const std::string_view footer = zeroCopyMessages::footer;
+            m_offsets.resize(1);
+            for (const auto & payload : payloads)
+                m_offsets.push_back(m_offsets.back() + zeroCopyMessages::completeMessageSize(payload));
+            m_arena.resize(m_offsets.back());
+
+            char * out = &m_arena[0];
+            for (const auto & payload : payloads)
+            {
+                std::string_view rawData(payload);
+                std::memcpy(out, header.data(), header.size());
+                std::memcpy(out + header.size(), rawData.data(), rawData.size());
+                std::memcpy(out + header.size() + rawData.size(), footer.data(), footer.size());
+                out += header.size() + rawData.size() + footer.size();
+            }
+            encryptor(&m_arena[0], m_arena.size());
+            return *this;
+        }
+    };
+
+    std::vector<std::string> makePayloads(size_t count)
+    {
+        std::mt19937 random(3);
+        std::uniform_int_distribution<int> length(0, 256);
+        std::uniform_int_distribution<int> byte(32, 126);
+        std::vector<std::string> payloads(count);
+        for (auto & payload : payloads)
+        {
+            payload.resize(length(random));
+            for (auto & c : payload)
+                c = static_cast<char>(byte(random));
+        }
+        return payloads;
+    }
+
+    // Every message of a batch must be the message buildCompleteMessage makes of its payload
+    bool test()
+    {
+        functionObjectsAndFunctors::Encryptor encryptor(false, 2);
+        MessageBatch batch;
+        bool passed = true;
+        for (size_t count : { 0, 1, 1000, 10 })
+        {
+            std::vector<std::string> payloads = makePayloads(count);
+            batch.build(payloads, encryptor);
+            passed = passed && batch.size() == count;
+            for (size_t i = 0; i < count && passed; ++i)
+                passed = batch[i] == functionObjectsAndFunctors::buildCompleteMessage(payloads[i], encryptor);
+        }
+        const char * literals[] = { "SampleString", "" };
+        batch.build(literals, encryptor);
+        std::cout << batch[0] << " " << batch[1] << std::endl;
+        std::cout << "batch messages -> " << (passed ? "PASSED" : "FAILED") << std::endl;
+        return passed;
+    }
+
+    // Messages per second and heap allocations per batch of 20000 messages,
+    // for the per message loop of test2() and for a reused batch
+    void benchmark()
+    {
+        const size_t messagesPerBatch = 20000;
+        const int batches = 50;
+        std::vector<std::string> payloads = makePayloads(messagesPerBatch);
+        functionObjectsAndFunctors::Encryptor encryptor(true, 1);
+        // Keeps the compiler from dropping the work
+        volatile size_t sink = 0;
+
+        std::vector<std::string> messages;
+        long long before = allocationCounting::count();
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < batches; ++round)
+        {
+            messages.clear();
+            for (const auto & payload : payloads)
+                messages.push_back(functionObjectsAndFunctors::buildCompleteMessage(payload, encryptor));
+            sink += messages.size();
+        }
+        auto loopDone = std::chrono::steady_clock::now();
+        long long loopAllocations = allocationCounting::count() - before;
+
+        MessageBatch batch;
+        before = allocationCounting::count();
+        auto batchStart = std::chrono::steady_clock::now();
+        for (int round = 0; round < batches; ++round)
+            sink += batch.build(payloads, encryptor).size();
+        auto batchDone = std::chrono::steady_clock::now();
+        long long batchAllocations = allocationCounting::count() - before;
+
+        bool same = batch.size() == messages.size();
+        for (size_t i = 0; i < messages.size() && same; ++i)
+            same = batch[i] == messages[i];
+
+        auto rate = [&](std::chrono::steady_clock::duration duration) {
+            return double(messagesPerBatch) * batches / std::chrono::duration<double>(duration).count() / 1e6;
+        };
+        std::cout << "per message loop : " << rate(loopDone - start) << " M messages/s, "
+                  << double(loopAllocations) / batches << " allocations per batch" << std::endl;
+        std::cout << "batch            : " << rate(batchDone - batchStart) << " M messages/s, "
+                  << double(batchAllocations) / batches << " allocations per batch"
+                  << (same ? "" : "  Error : messages differ") << std::endl;
+    }
+}
+
+namespace streamingEncryptor {
+    // buildCompleteMessage needs the whole message in a std::string, a 20 GB log would need 20 GB of memory.
+    // Here the input is read in chunks of a fixed size, either with read() or from an mmap of the file,
+    // every chunk is encrypted in place and written to the output while the next chunk is being read.
+    // The header goes in front of the first chunk and the footer after the last one,
+    // so the output is exactly what buildCompleteMessage would make of the whole input.
+    // The encryptor must work byte by byte (like all the encryptors here), so chunk borders don't matter.
+    const size_t DefaultChunkSize = 1024 * 1024;
+
+    // Writes the buffers it is given on a thread of its own, while the caller fills the other buffer
+    class DoubleBufferedWriter
+    {
+        int m_fd;
+        std::vector<char> m_buffers[2];
+        int m_filling;              // buffer the caller fills
+        size_t m_pendingSize;       // size of the buffer handed to the writer thread, 0 if there is none
+        bool m_done;
+        bool m_failed;
+        std::mutex m_mutex;
+        std::condition_variable m_condVar;
+        std::thread m_thread;
+
+        static bool writeAll(int fd, const char * data, size_t size)
+        {
+            while (size > 0)
+            {
+                ssize_t written = ::write(fd, data, size);
+                if (written < 0 && errno == EINTR)
+                    continue;
+                if (written <= 0)
+                    return false;
+                data += written;
+                size -= written;
+            }
+            return true;
+        }
+
+        void run()
+        {
+            std::unique_lock<std::mutex> mlock(m_mutex);
+            while (true)
+            {
+                m_condVar.wait(mlock, [this]() { return m_pendingSize > 0 || m_done; });
+                if (m_pendingSize == 0)
+                    break;
+                const char * data = m_buffers[1 - m_filling].data();
+                size_t size = m_pendingSize;
+                mlock.unlock();
+                bool ok = writeAll(m_fd, data, size);
+                mlock.lock();
+                m_failed = m_failed || !ok;
+                m_pendingSize = 0;
+                m_condVar.notify_all();
+            }
+        }
+
+    public:
+        DoubleBufferedWriter(int fd, size_t bufferSize)
+            : m_fd(fd), m_filling(0), m_pendingSize(0), m_done(false), m_failed(false)
+        {
+            m_buffers[0].resize(bufferSize);
+            m_buffers[1].resize(bufferSize);
+            m_thread = std::thread(&DoubleBufferedWriter::run, this);
+        }
+
+        ~DoubleBufferedWriter()
+        {
+            finish();
+        }
+
+        char * buffer()
+        {
+            return m_buffers[m_filling].data();
+        }
+
+        size_t bufferSize() const
+        {
+            return m_buffers[0].size();
+        }
+
+        // Hands the filled buffer to the writer thread, waits till the other one is written
+        void submit(size_t size)
+        {
+            if (size == 0)
+                return;
+            std::unique_lock<std::mutex> mlock(m_mutex);
+            m_condVar.wait(mlock, [this]() { return m_pendingSize == 0; });
+            m_filling = 1 - m_filling;
+            m_pendingSize = size;
+            m_condVar.notify_all();
+        }
+
+        // Waits till everything is written, returns false if a write failed
+        bool finish()
+        {
+            {
+                std::unique_lock<std::mutex> mlock(m_mutex);
+                m_condVar.wait(mlock, [this]() { return m_pendingSize == 0; });
+                m_done = true;
+            }
+            m_condVar.notify_all();
+            if (m_thread.joinable())
+                m_thread.join();
+            return !m_failed;
+        }
+    };
+
+    // Reads the input with read()
+    class ReadSource
+    {
+        int m_fd;
+    public:
+        explicit ReadSource(int fd) : m_fd(fd) {}
+
+        // Returns 0 at the end of the input, -1 on an error
+        ssize_t read(char * buffer, size_t size)
+        {
+            while (true)
+            {
+                ssize_t count = ::read(m_fd, buffer, size);
+                if (count < 0 && errno == EINTR)
+                    continue;
+                return count;
+            }
+        }
+    };
+
+    // Reads the input from an mmap of the whole file. Pages that were copied out are given back,
+    // so the resident memory stays at a few chunks however big the file is.
+    class MmapSource
+    {
+        const char * m_data;
+        size_t m_size;
+        size_t m_position;
+    public:
+        explicit MmapSource(int fd) : m_data(nullptr), m_size(0), m_position(0)
+        {
+            struct stat info;
+            if (fstat(fd, &info) != 0 || info.st_size == 0)
+                return;
+            void * data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED)
+                return;
+            madvise(data, info.st_size, MADV_SEQUENTIAL);
+            m_data = static_cast<const char *>(data);
+            m_size = info.st_size;
+        }
+
+        ~MmapSource()
+        {
+            if (m_data)
+                munmap(const_cast<char *>(m_data), m_size);
+        }
+
+        bool valid() const
+        {
+            return m_data != nullptr;
+        }
+
+        ssize_t read(char * buffer, size_t size)
+        {
+            size = std::min(size, m_size - m_position);
+            std::memcpy(buffer, m_data + m_position, size);
+            // Whole pages behind us aren't needed any more
+            size_t pageSize = sysconf(_SC_PAGESIZE);
+            size_t done = (m_position + size) / pageSize * pageSize;
+            size_t released = m_position / pageSize * pageSize;
+            if (done > released)
+                madvise(const_cast<char *>(m_data) + released, done - released, MADV_DONTNEED);
+            m_position += size;
+            return size;
+        }
+    };
+
+    // Writes header + encrypted input + footer to outFd, returns false on a read or write error
+    template <typename Source, typename InPlaceEncryptor>
+    bool encryptStream(Source & source, int outFd, InPlaceEncryptor encryptor, size_t chunkSize = DefaultChunkSize)
+    {
+        const std::string_view header = zeroCopyMessages::header;
+        const std::string_view footer = zeroCopyMessages::footer;
+        chunkSize = std::max(chunkSize, header.size() + 1);
+        DoubleBufferedWriter writer(outFd, chunkSize + footer.size());
+
+        bool first = true;
+        bool end = false;
+        while (!end)
+        {
+            char * buffer = writer.buffer();
+            size_t used = 0;
+            if (first)
+            {
+                std::memcpy(buffer, header.data(), header.size());
+                used = header.size();
+                first = false;
+            }
+            while (used < chunkSize)
+            {
+                ssize_t count = source.read(buffer + used, chunkSize - used);
+                if (count < 0)
+                {
+                    writer.finish();
+                    return false;
+                }
+                if (count == 0)
+                {
+                    end = true;
+                    break;
+                }
+                used += count;
+            }
+            if (end)
+            {
+                std::memcpy(buffer + used, footer.data(), footer.size());
+                used += footer.size();
+            }
+            encryptor(buffer, used);
+            writer.submit(used);
+        }
+        return writer.finish();
+    }
+
+    // callbacks --encrypt [--mmap] [--shift N] [--chunk KB] <input file | -> <output file | ->
+    int runCli(int argc, char * argv[])
+    {
+        bool useMmap = false;
+        int shift = 1;
+        size_t chunkSize = DefaultChunkSize;
+        std::vector<std::string> files;
+        for (int i = 2; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg == "--mmap")
+                useMmap = true;
+            else if (arg == "--shift" && i + 1 < argc)
+                shift = std::atoi(argv[++i]);
+            else if (arg == "--chunk" && i + 1 < argc)
+                chunkSize = std::max(1, std::atoi(argv[++i])) * size_t(1024);
+            else
+                files.push_back(arg);
+        }
+        if (files.size() != 2)
+        {
+            std::cerr << "usage: " << argv[0] << " --encrypt [--mmap] [--shift N] [--chunk KB] <input | -> <output | ->" << std::endl;
+            return 2;
+        }
+
+        // The output is only created (and truncated) once the input could be opened
+        int inFd = files[0] == "-" ? STDIN_FILENO : ::open(files[0].c_str(), O_RDONLY);
+        if (inFd < 0)
+        {
+            std::cerr << "Error : can't open " << files[0] << " : " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+        int outFd = files[1] == "-" ? STDOUT_FILENO : ::open(files[1].c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (outFd < 0)
+        {
+            std::cerr << "Error : can't open " << files[1] << " : " << std::strerror(errno) << std::endl;
+            if (inFd != STDIN_FILENO)
+                ::close(inFd);
+            return 1;
+        }
+
+        auto encryptor = [shift](char * data, size_t size) { simdLetterShift::shiftLetters(data, size, shift); };
+        bool ok = false;
+        bool streamed = false;
+        if (useMmap)
+        {
+            MmapSource mapped(inFd);
+            if (mapped.valid())
+            {
+                ok = encryptStream(mapped, outFd, encryptor, chunkSize);
+                streamed = true;
+            }
+        }
+        if (!streamed)
+        {
+            // Pipes and empty files can't be mapped
+            ReadSource reader(inFd);
+            ok = encryptStream(reader, outFd, encryptor, chunkSize);
+        }
+        if (!ok)
+            std::cerr << "Error : " << std::strerror(errno) << std::endl;
+        if (inFd != STDIN_FILENO)
+            ::close(inFd);
+        if (outFd != STDOUT_FILENO && ::close(outFd) != 0)
+            ok = false;
+        return ok ? 0 : 1;
+    }
+
+    // Peak resident memory since the last resetPeakMemory()
+    long peakMemoryKb()
+    {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            if (line.compare(0, 6, "VmHWM:") == 0)
+                return std::atol(line.c_str() + 6);
+        }
+        return 0;
+    }
+
+    void resetPeakMemory()
+    {
+        std::ofstream("/proc/self/clear_refs") << "5";
+    }
+
+    // Encrypts a 256 MB file with the whole string path (read all, buildCompleteMessage, write all)
+    // and with the streaming paths, and checks that all of them write the same output
+    void benchmark()
+    {
+        const size_t fileSize = 256 * 1024 * 1024;
+        const std::string inputName = "/tmp/streamingEncryptorInput";
+        const std::string outputName = "/tmp/streamingEncryptorOutput";
+        {
+            std::string block(1024 * 1024, '\0');
+            std::mt19937 random(1);
+            std::uniform_int_distribution<int> byte(32, 126);
+            for (auto & c : block)
+                c = static_cast<char>(byte(random));
+            std::ofstream input(inputName, std::ios::binary);
+            for (size_t written = 0; written < fileSize; written += block.size())
+                input.write(block.data(), block.size());
+        }
+
+        std::string reference;
+        for (int mode = 0; mode < 3; ++mode)
+        {
+            resetPeakMemory();
+            long memoryBefore = peakMemoryKb();
+            auto start = std::chrono::steady_clock::now();
+            int inFd = ::open(inputName.c_str(), O_RDONLY);
+            int outFd = ::open(outputName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            auto encryptor = [](char * data, size_t size) { simdLetterShift::shiftLetters(data, size, 1); };
+            const char * name;
+            if (mode == 0)
+            {
+                name = "whole string ";
+                std::stringstream content;
+                content << std::ifstream(inputName, std::ios::binary).rdbuf();
+                std::string message = functionObjectsAndFunctors::buildCompleteMessage(content.str(), functionObjectsAndFunctors::Encryptor(true, 1));
+                if (::write(outFd, message.data(), message.size()) != static_cast<ssize_t>(message.size()))
+                    std::cout << "Error : write failed" << std::endl;
+            }
+            else if (mode == 1)
+            {
+                name = "read() chunks";
+                ReadSource source(inFd);
+                encryptStream(source, outFd, encryptor);
+            }
+            else
+            {
+                name = "mmap chunks  ";
+                MmapSource source(inFd);
+                encryptStream(source, outFd, encryptor);
+            }
+            ::close(inFd);
+            ::close(outFd);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            long peakIncrease = peakMemoryKb() - memoryBefore;
+
+            std::stringstream output;
+            output << std::ifstream(outputName, std::ios::binary).rdbuf();
+            if (mode == 0)
+                reference = output.str();
+            bool same = output.str() == reference;
+            std::cout << name << " : " << fileSize / seconds / 1e6 << " MB/s, peak resident memory + "
+                      << peakIncrease / 1024 << " MB" << (same ? "" : "  Error : output differs") << std::endl;
+        }
+        std::remove(inputName.c_str());
+        std::remove(outputName.c_str());
+    }
+}
+
+namespace parallelEncryption {
+    // Every letter is shifted on its own, so a big buffer can be cut into chunks that are encrypted
+    // on different cores. The chunks are small enough to stay in the L2 cache of the core that works on them,
+    // and are handed out one by one, so a slow core simply takes fewer of them.
+    // Below a threshold starting the threads costs more than it saves, and the buffer is encrypted on the calling thread.
+
+    // A few threads that run the tasks of one job at a time, the thread that starts a job works on it too
+    class ThreadPool
+    {
+        std::vector<std::thread> m_threads;
+        std::mutex m_runMutex;                  // one job at a time
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_finished;
+        const std::function<void(size_t)> * m_task;
+        size_t m_taskCount;
+        std::atomic<size_t> m_nextTask;
+        size_t m_wantedWorkers;                 // workers that may still join the current job
+        size_t m_activeWorkers;                 // workers working on the current job
+        unsigned m_generation;
+        bool m_stop;
+
+        void runTasks()
+        {
+            for (size_t index = m_nextTask++; index < m_taskCount; index = m_nextTask++)
+                (*m_task)(index);
+        }
+
+        void worker()
+        {
+            unsigned seenGeneration = 0;
+            std::unique_lock<std::mutex> mlock(m_mutex);
+            while (true)
+            {
+                m_wake.wait(mlock, [&]() { return m_stop || m_generation != seenGeneration; });
+                if (m_stop)
+                    return;
+                seenGeneration = m_generation;
+                if (m_wantedWorkers == 0)
+                    continue;
+                --m_wantedWorkers;
+                ++m_activeWorkers;
+                mlock.unlock();
+                runTasks();
+                mlock.lock();
+                if (--m_activeWorkers == 0)
+                    m_finished.notify_all();
+            }
+        }
+
+    public:
+        explicit ThreadPool(size_t workers)
+            : m_task(nullptr), m_taskCount(0), m_nextTask(0), m_wantedWorkers(0), m_activeWorkers(0), m_generation(0), m_stop(false)
+        {
+            for (size_t i = 0; i < workers; ++i)
+                m_threads.emplace_back(&ThreadPool::worker, this);
+        }
+
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> mlock(m_mutex);
+                m_stop = true;
+            }
+            m_wake.notify_all();
+            for (auto & thread : m_threads)
+                thread.join();
+        }
+
+        // One pool for the whole program, one thread per core (the caller is one of them)
+        static ThreadPool & instance()
+        {
+            static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+            return pool;
+        }
+
+        // Threads that can work on a job, the caller included
+        size_t maxThreads() const
+        {
+            return m_threads.size() + 1;
+        }
+
+        // Calls task(0) ... task(taskCount - 1) on up to maxThreads threads and returns when all are done
+        void run(size_t taskCount, const std::function<void(size_t)> & task, size_t maxThreads)
+        {
+            maxThreads = std::min({ maxThreads, this->maxThreads(), taskCount });
+            if (maxThreads <= 1)
+            {
+                for (size_t index = 0; index < taskCount; ++index)
+                    task(index);
+                return;
+            }
+
+            std::lock_guard<std::mutex> runLock(m_runMutex);
+            {
+                std::lock_guard<std::mutex> mlock(m_mutex);
+                m_task = &task;
+                m_taskCount = taskCount;
+                m_nextTask = 0;
+                m_wantedWorkers = maxThreads - 1;
+                ++m_generation;
+            }
+            m_wake.notify_all();
+            runTasks();
+
+            // All tasks were taken, wait for the workers that are still busy with theirs
+            std::unique_lock<std::mutex> mlock(m_mutex);
+            m_wantedWorkers = 0;
+            m_finished.wait(mlock, [this]() { return m_activeWorkers == 0; });
+            m_task = nullptr;
+        }
+    };
+
+    // Encrypts like functionObjectsAndFunctors::Encryptor, on several cores if the buffer is big enough
+    class ParallelEncryptor
+    {
+        functionObjectsAndFunctors::Encryptor m_encryptor;
+        ThreadPool & m_pool;
+        size_t m_maxThreads;
+        size_t m_threshold;
+        size_t m_chunkSize;
+    public:
+        static const size_t DefaultThreshold = 1024 * 1024;
+        static const size_t DefaultChunkSize = 256 * 1024;
+
+        ParallelEncryptor(bool isInc, int count, size_t maxThreads = 0, ThreadPool & pool = ThreadPool::instance(),
+                          size_t threshold = DefaultThreshold, size_t chunkSize = DefaultChunkSize)
+            : m_encryptor(isInc, count), m_pool(pool), m_maxThreads(maxThreads ? maxThreads : pool.maxThreads()),
+              m_threshold(threshold), m_chunkSize(std::max<size_t>(chunkSize, 1))
+        {
+        }
+
+        std::string operator()(std::string data) const
+        {
+            (*this)(&data[0], data.size());
+            return data;
+        }
+
+        void operator()(char * data, size_t size) const
+        {
+            if (size < m_threshold || m_maxThreads <= 1)
+            {
+                m_encryptor(data, size);
+                return;
+            }
+            size_t chunks = (size + m_chunkSize - 1) / m_chunkSize;
+            m_pool.run(chunks, [&](size_t index) {
+                size_t begin = index * m_chunkSize;
+                m_encryptor(data + begin, std::min(m_chunkSize, size - begin));
+            }, m_maxThreads);
+        }
+    };
+
+    // The parallel output must be exactly the serial one, whatever the size, thread count and chunk size
+    void test()
+    {
+        std::mt19937 random(7);
+        std::uniform_int_distribution<int> byte(0, 255);
+        ThreadPool pool(3);
+        bool ok = true;
+        for (size_t size : { 0, 1, 4095, 4096, 100000, 1000003 })
+        {
+            std::string input(size, '\0');
+            for (auto & c : input)
+                c = static_cast<char>(byte(random));
+            for (bool isInc : { true, false })
+            {
+                std::string expected = functionObjectsAndFunctors::Encryptor(isInc, 3)(input);
+                for (size_t threads : { 1, 2, 4 })
+                {
+                    for (size_t chunkSize : { 1, 1000, 65536 })
+                    {
+                        ParallelEncryptor encryptor(isInc, 3, threads, pool, 0, chunkSize);
+                        if (encryptor(input) != expected)
+                        {
+                            std::cout << "Error : size " << size << ", " << threads << " threads, chunks of " << chunkSize << std::endl;
+                            ok = false;
+                        }
+                    }
+                }
+            }
+        }
+        std::cout << (ok ? "parallel output is the serial output" : "parallel output differs") << std::endl;
+    }
+
+    // Printable text that can be made again without keeping a copy
+    void fillText(std::string & text)
+    {
+        std::uint32_t state = 1;
+        for (auto & c : text)
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            c = static_cast<char>(32 + state % 95);
+        }
+    }
+
+    std::uint64_t checksum(const std::string & text)
+    {
+        // FNV-1a
+        std::uint64_t hash = 14695981039346656037ull;
+        for (char c : text)
+            hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        return hash;
+    }
+
+    // Throughput from 1 to N threads for 1 MB, 64 MB and 1 GB, compared against the serial Encryptor.
+    // Only one buffer of each size is kept, the parallel results are checked against the checksum of the serial one.
+    void benchmark()
+    {
+        auto & pool = ThreadPool::instance();
+        std::cout << pool.maxThreads() << " hardware threads" << std::endl;
+        // Powers of two below N, then N
+        std::vector<size_t> threadCounts;
+        for (size_t threads = 1; threads < pool.maxThreads(); threads *= 2)
+            threadCounts.push_back(threads);
+        threadCounts.push_back(pool.maxThreads());
+
+        for (size_t size : { size_t(1) << 20, size_t(64) << 20, size_t(1) << 30 })
+        {
+            std::string buffer(size, '\0');
+            fillText(buffer);
+            functionObjectsAndFunctors::Encryptor(true, 1)(&buffer[0], buffer.size());
+            std::uint64_t expected = checksum(buffer);
+
+            // Small buffers are encrypted many times, so every measurement takes a while
+            size_t rounds = std::max<size_t>(1, (size_t(512) << 20) / size);
+            auto measure = [&](auto encryptor) {
+                auto start = std::chrono::steady_clock::now();
+                for (size_t round = 0; round < rounds; ++round)
+                    encryptor(&buffer[0], buffer.size());
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                return double(size) * rounds / seconds / 1e6;
+            };
+
+            double serial = measure(functionObjectsAndFunctors::Encryptor(true, 1));
+            std::cout << (size >> 20) << " MB, serial : " << serial << " MB/s" << std::endl;
+            for (size_t threads : threadCounts)
+            {
+                double rate = measure(ParallelEncryptor(true, 1, threads, pool, 0));
+                fillText(buffer);
+                ParallelEncryptor(true, 1, threads, pool, 0)(&buffer[0], buffer.size());
+                std::cout << (size >> 20) << " MB, " << threads << " threads : " << rate << " MB/s, x" << rate / serial
+                          << (checksum(buffer) == expected ? "" : "  Error : output differs") << std::endl;
+            }
+        }
+    }
+}
+
+namespace callbackTypes {
+    // A function pointer can't carry any state, a functor parameter ties the API to one type,
+    // and std::function copies the callable to the heap when it is bigger than a few pointers.
+    //
+    // function_ref only points to a callable that lives somewhere else, it is two pointers and never allocates.
+    // It is meant for parameters of callbacks that are called before the function returns,
+    // never keep one after the callable it was made from is gone.
+    //
+    // inplace_function owns a copy of the callable like std::function, but in a buffer of Capacity bytes
+    // inside the object, a callable that doesn't fit is a compile error instead of a heap allocation.
+
+    template <typename Signature>
+    class function_ref;
+
+    template <typename R, typename... Args>
+    class function_ref<R(Args...)>
+    {
+        // Functions can't be pointed to by a void *
+        union Target
+        {
+            void * object;
+            R (*function)(Args...);
+        };
+        Target m_target;
+        R (*m_call)(Target, Args &&...);
+
+    public:
+        function_ref(R (*function)(Args...)) noexcept
+        {
+            m_target.function = function;
+            m_call = [](Target target, Args &&... args) -> R {
+                return target.function(std::forward<Args>(args)...);
+            };
+        }
+
+        // Functors and lambdas, captureless ones included, are called where they are
+        template <typename F, typename = std::enable_if_t<
+            !std::is_same_v<std::decay_t<F>, function_ref> &&
+            !std::is_function_v<std::remove_reference_t<F>> &&
+            std::is_invocable_r_v<R, F &, Args...>>>
+        function_ref(F && callable) noexcept
+        {
+            using Callable = std::remove_reference_t<F>;
+            m_target.object = const_cast<void *>(static_cast<const void *>(std::addressof(callable)));
+            m_call = [](Target target, Args &&... args) -> R {
+                return (*static_cast<Callable *>(target.object))(std::forward<Args>(args)...);
+            };
+        }
+
+        R operator()(Args... args) const
+        {
+            return m_call(m_target, std::forward<Args>(args)...);
+        }
+    };
+
+    template <typename Signature, size_t Capacity = 32, size_t Alignment = alignof(std::max_align_t)>
+    class inplace_function;
+
+    template <typename R, typename... Args, size_t Capacity, size_t Alignment>
+    class inplace_function<R(Args...), Capacity, Alignment>
+    {
+        // What can be done with the callable in m_storage, one table for each type of callable
+        struct Operations
+        {
+            R (*call)(void * storage, Args &&... args);
+            void (*copy)(void * to, const void * from);
+            void (*move)(void * to, void * from);
+            void (*destroy)(void * storage);
+        };
+
+        template <typename Callable>
+        static const Operations * operationsFor()
+        {
+            static const Operations operations = {
+                [](void * storage, Args &&... args) -> R {
+                    return (*static_cast<Callable *>(storage))(std::forward<Args>(args)...);
+                },
+                [](void * to, const void * from) { new (to) Callable(*static_cast<const Callable *>(from)); },
+                [](void * to, void * from) { new (to) Callable(std::move(*static_cast<Callable *>(from))); },
+                [](void * storage) { static_cast<Callable *>(storage)->~Callable(); }
+            };
+            return &operations;
+        }
+
+        alignas(Alignment) unsigned char m_storage[Capacity];
+        const Operations * m_operations;
+
+    public:
+        inplace_function() noexcept : m_operations(nullptr) {}
+
+        template <typename F, typename = std::enable_if_t<
+            !std::is_same_v<std::decay_t<F>, inplace_function> &&
+            std::is_invocable_r_v<R, std::decay_t<F> &, Args...>>>
+        inplace_function(F && callable) : m_operations(nullptr)
+        {
+            using Callable = std::decay_t<F>;
+            static_assert(sizeof(Callable) <= Capacity, "the callable is bigger than the Capacity of the inplace_function");
+            static_assert(Alignment % alignof(Callable) == 0, "the callable needs a bigger Alignment than the inplace_function has");
+            if constexpr (std::is_pointer_v<Callable>)
+            {
+                if (callable == nullptr)
+                    return;
+            }
+            new (m_storage) Callable(std::forward<F>(callable));
+            m_operations = operationsFor<Callable>();
+        }
+
+        inplace_function(const inplace_function & other) : m_operations(other.m_operations)
+        {
+            if (m_operations)
+                m_operations->copy(m_storage, other.m_storage);
+        }
+
+        inplace_function(inplace_function && other) : m_operations(other.m_operations)
+        {
+            if (m_operations)
+                m_operations->move(m_storage, other.m_storage);
+        }
+
+        ~inplace_function()
+        {
+            reset();
+        }
+
+        inplace_function & operator=(const inplace_function & other)
+        {
+            if (this != &other)
+            {
+                reset();
+                if (other.m_operations)
+                    other.m_operations->copy(m_storage, other.m_storage);
+                m_operations = other.m_operations;
+            }
+            return *this;
+        }
+
+        inplace_function & operator=(inplace_function && other)
+        {
+            if (this != &other)
+            {
+                reset();
+                if (other.m_operations)
+                    other.m_operations->move(m_storage, other.m_storage);
+                m_operations = other.m_operations;
+            }
+            return *this;
+        }
+
+        void reset()
+        {
+            if (m_operations)
+                m_operations->destroy(m_storage);
+            m_operations = nullptr;
+        }
+
+        explicit operator bool() const
+        {
+            return m_operations != nullptr;
+        }
+
+        // Like std::function, the callable is called as non const even through a const inplace_function
+        R operator()(Args... args) const
+        {
+            if (!m_operations)
+                throw std::bad_function_call();
+            return m_operations->call(const_cast<unsigned char *>(m_storage), std::forward<Args>(args)...);
+        }
+    };
+
+    using EncryptorRef = function_ref<void(char *, size_t)>;
+
+    // The message builder with either callback type, a lambda or functor passed directly becomes a function_ref
+    std::string & buildCompleteMessage(std::string_view rawData, std::string & out, EncryptorRef encryptor)
+    {
+        return zeroCopyMessages::buildCompleteMessage(rawData, out, encryptor);
+    }
+
+    template <size_t Capacity, size_t Alignment>
+    std::string & buildCompleteMessage(std::string_view rawData, std::string & out,
+                                       const inplace_function<void(char *, size_t), Capacity, Alignment> & encryptor)
+    {
+        return zeroCopyMessages::buildCompleteMessage(rawData, out, encryptor);
+    }
+
+    void test()
+    {
+        std::string message;
+        int shift = 2;
+        auto capturing = [shift](char * data, size_t size) { simdLetterShift::shiftLetters(data, size, shift); };
+
+        std::cout << buildCompleteMessage("SampleString", message, &zeroCopyMessages::encryptDataByLetterInc) << std::endl;
+        std::cout << buildCompleteMessage("SampleString", message, capturing) << std::endl;
+        std::cout << buildCompleteMessage("SampleString", message, [](char * data, size_t size) { simdLetterShift::shiftLetters(data, size, -1); }) << std::endl;
+        std::cout << buildCompleteMessage("SampleString", message, functionObjectsAndFunctors::Encryptor(false, 1)) << std::endl;
+
+        inplace_function<void(char *, size_t), 16> owned = capturing;
+        inplace_function<void(char *, size_t), 16> copy = owned;
+        owned = functionObjectsAndFunctors::Encryptor(true, 3);
+        std::cout << buildCompleteMessage("SampleString", message, owned) << std::endl;
+        std::cout << buildCompleteMessage("SampleString", message, copy) << std::endl;
+
+        // Doesn't compile : 64 bytes of state don't fit into 16
+        // char key[64] = {};
+        // inplace_function<void(char *, size_t), 16> tooBig = [key](char *, size_t) { (void)key; };
+    }
+
+    // A callback with 40 bytes of state, more than std::function keeps without allocating
+    struct KeyedEncryptor
+    {
+        int shift;
+        char key[36];
+
+        void operator()(char * data, size_t size) const
+        {
+            simdLetterShift::shiftLetters(data, size, shift + key[0]);
+        }
+    };
+
+    // Heap allocations per message and time per call of the message builder with each callback type
+    void benchmark()
+    {
+        const int count = 5000000;
+        const std::string payload(16, 'p');
+        std::string message;
+        KeyedEncryptor encryptor = { 1, {} };
+        // Keeps the compiler from dropping the calls
+        volatile size_t sink = 0;
+
+        auto measure = [&](const char * name, auto makeCallback) {
+            zeroCopyMessages::buildCompleteMessage(payload, message, encryptor);
+            long long before = allocationCounting::count();
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < count; ++i)
+            {
+                // A new callback for every message, the way a callback parameter is made at every call
+                auto callback = makeCallback();
+                sink += zeroCopyMessages::buildCompleteMessage(payload, message, std::cref(callback)).size();
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            long long allocations = allocationCounting::count() - before;
+            std::cout << name << " : " << seconds * 1e9 / count << " ns per message, "
+                      << double(allocations) / count << " allocations per message" << std::endl;
+        };
+
+        measure("functor directly    ", [&]() { return encryptor; });
+        measure("function_ref        ", [&]() { return EncryptorRef(encryptor); });
+        measure("inplace_function<48>", [&]() { return inplace_function<void(char *, size_t), 48>(encryptor); });
+        measure("std::function       ", [&]() { return std::function<void(char *, size_t)>(encryptor); });
+    }
+}
+
+int main(int argc, char * argv[])
 {
+    if (argc > 1 && std::string(argv[1]) == "--encrypt")
+        return streamingEncryptor::runCli(argc, argv);
+
+    //simdLetterShift::propertyTest();
+    //simdLetterShift::benchmark();
+
+    //zeroCopyMessages::test();
+    //zeroCopyMessages::allocationTest();
+    //zeroCopyMessages::benchmark();
+
+    //compileTimeTransforms::test();
+    //compileTimeTransforms::benchmark();
+
+    //batchMessages::test();
+    //batchMessages::benchmark();
+
+    //streamingEncryptor::benchmark();
+
+    //parallelEncryption::test();
+    //parallelEncryption::benchmark();
+
+    //callbackTypes::test();
+    //callbackTypes::benchmark();
+
     functionPointers::test();
 
     functionObjectsAndFunctors::test2();
@@ -0,0 +1,90 @@
+#ifndef ALLOCATION_COUNTING_H
+#define ALLOCATION_COUNTING_H
+
+// Counts the heap allocations of a program, so the examples can show how many they make.
+// It replaces every form of the global operator new and operator delete (plain, array, nothrow, aligned),
+// so whatever the library allocates with one form and frees with another still goes through malloc / free.
+// Replacement functions can't be inline: include this header in exactly one source file of an executable.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace allocationCounting {
+    std::atomic<long long> allocations(0);
+
+    long long count()
+    {
+        return allocations.load(std::memory_order_relaxed);
+    }
+
+    void * allocate(std::size_t size) noexcept
+    {
+        return std::malloc(size ? size : 1);
+    }
+
+    void * allocate(std::size_t size, std::align_val_t alignment) noexcept
+    {
+        std::size_t align = static_cast<std::size_t>(alignment);
+        if (align < sizeof(void *))
+            align = sizeof(void *);
+        void * ptr = nullptr;
+        if (posix_memalign(&ptr, align, size ? size : 1) != 0)
+            return nullptr;
+        return ptr;
+    }
+
+    // Calls the new_handler till the allocation works, like the library operator new
+    template <typename... Alignment>
+    void * allocateOrThrow(std::size_t size, Alignment... alignment)
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        while (true)
+        {
+            if (void * ptr = allocate(size, alignment...))
+                return ptr;
+            std::new_handler handler = std::get_new_handler();
+            if (!handler)
+                throw std::bad_alloc();
+            handler();
+        }
+    }
+
+    template <typename... Alignment>
+    void * allocateOrNull(std::size_t size, Alignment... alignment) noexcept
+    {
+        try
+        {
+            return allocateOrThrow(size, alignment...);
+        }
+        catch (...)
+        {
+            return nullptr;
+        }
+    }
+}
+
+void * operator new(std::size_t size) { return allocationCounting::allocateOrThrow(size); }
+void * operator new[](std::size_t size) { return allocationCounting::allocateOrThrow(size); }
+void * operator new(std::size_t size, const std::nothrow_t &) noexcept { return allocationCounting::allocateOrNull(size); }
+void * operator new[](std::size_t size, const std::nothrow_t &) noexcept { return allocationCounting::allocateOrNull(size); }
+void * operator new(std::size_t size, std::align_val_t alignment) { return allocationCounting::allocateOrThrow(size, alignment); }
+void * operator new[](std::size_t size, std::align_val_t alignment) { return allocationCounting::allocateOrThrow(size, alignment); }
+void * operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept { return allocationCounting::allocateOrNull(size, alignment); }
+void * operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept { return allocationCounting::allocateOrNull(size, alignment); }
+
+void operator delete(void * ptr) noexcept { std::free(ptr); }
+void operator delete[](void * ptr) noexcept { std::free(ptr); }
+void operator delete(void * ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void * ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void * ptr, const std::nothrow_t &) noexcept { std::free(ptr); }
+void operator delete[](void * ptr, const std::nothrow_t &) noexcept { std::free(ptr); }
+void operator delete(void * ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void * ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void * ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void * ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void * ptr, std::align_val_t, const std::nothrow_t &) noexcept { std::free(ptr); }
+void operator delete[](void * ptr, std::align_val_t, const std::nothrow_t &) noexcept { std::free(ptr); }
+
+#endif
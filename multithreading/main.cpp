@@ -7,6 +7,45 @@
 #include <mutex>
 #include <condition_variable>
 #include <future>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <climits>
+#include <map>
+#include <numeric>
+#include <fstream>
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <sstream>
+#include <system_error>
+#include <stdexcept>
+#include <tuple>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <shared_mutex>
+#include "../common/allocation_counting.h"
+#ifdef __linux__
+#include <sched.h>
+#include <pthread.h>
+#endif
+
+// 1 = the mutexes of the examples record contention, see mutexProfiling
+#ifndef PROFILE_MUTEXES
+#define PROFILE_MUTEXES 0
+#endif
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#endif
 
 namespace threeDifferentWaysToCreateTheads {
     //In C++ 11 we can create additional threads by creating objects of std::thread class.
@@ -82,432 +121,3372 @@ namespace threeDifferentWaysToCreateTheads {
     }
 }
 
-namespace joiningAndDetachingThreads {
-    //  std::thread th(funcPtr);
-    //  th.join();
-    class WorkerThread {
-    public:
-        void operator()()
-        {
-            std::cout << "Worker Thread " << std::this_thread::get_id() << " is Executing\n";
-        }
+namespace asyncLogging {
+    // std::cout << ... << std::endl from many threads makes every thread take the stream lock
+    // and flush the stream for every line, so the workers wait for each other and for the terminal.
+    // Here every thread appends its lines to its own ring buffer (single producer, single consumer).
+    // One background thread collects the lines of all rings, puts them in time order,
+    // optionally adds a time / thread prefix, and writes a whole batch with a single write().
+    //     asyncLogging::log() << "Passed Number = " << x;     // one line, the newline is added
+    // The calling thread only copies the text into a fixed buffer and the ring, it never allocates.
+    typedef std::chrono::steady_clock Clock;
+
+    struct RecordHeader {
+        std::uint64_t timeNs;
+        std::uint32_t size;
+        std::uint32_t threadIndex;
     };
 
-    void joiningThreads()
+    class Ring
     {
-        std::cout << "+++++++" << __FUNCTION__ << "+++++++\n";
-        std::vector<std::thread> threadList;
+    public:
+        enum { Capacity = 1 << 16 };
 
-        for (int i = 0; i < 10; ++i)
+    private:
+        alignas(64) std::atomic<size_t> m_head;     // read position, only moved by the logger thread
+        alignas(64) std::atomic<size_t> m_tail;     // write position, only moved by the owning thread
+        alignas(64) char m_buffer[Capacity];
+        std::atomic<bool> m_closed;
+        const std::uint32_t m_threadIndex;
+
+        static size_t padded(size_t size)
         {
-            threadList.push_back(std::thread(WorkerThread()));
+            return (size + 7) & ~size_t(7);
         }
 
-        // Now wait for all the worker thread to finish i.e.
-        // Call join() function on each of the std::thread object
-        std::cout << "Wait for all the worker threads to finish\n";
-        std::for_each(threadList.begin(), threadList.end(), std::mem_fn(&std::thread::join));
-        std::cout << "Exiting from Main Thread\n";
-    }
-
-    void detachingThreads()
-    {
-        std::cout << "+++++++" << __FUNCTION__ << "+++++++\n";
-        // Case 1: Never call join() or detach() on std::thread object with no associated executing thread
-        // Detached threads are also called daemon / Background threads.  
-        // To detach a thread we need to call std::detach() function on std::thread object i.e.
-        // std::thread th(funcPtr);
-        // th.detach();
-        // After calling detach(), std::thread object is no longer associated with the actual thread of execution.
-        // before calling join() or detach() we should check if thread is join - able every time i.e. threadObj.joinable()
-
-        // Case 2 : Never forget to call either join or detach on a std::thread object with associated executing thread
-        std::thread threadObj(WorkerThread());
-        return;
-    }
-}
+        void copyIn(size_t position, const void * data, size_t size)
+        {
+            size_t offset = position & (Capacity - 1);
+            size_t first = std::min(size, Capacity - offset);
+            std::memcpy(m_buffer + offset, data, first);
+            std::memcpy(m_buffer, static_cast<const char *>(data) + first, size - first);
+        }
 
-namespace passArgumentsToThreads {
-    // By default all arguments are copied into the internal storage of new thread.
+        void copyOut(size_t position, void * data, size_t size) const
+        {
+            size_t offset = position & (Capacity - 1);
+            size_t first = std::min(size, Capacity - offset);
+            std::memcpy(data, m_buffer + offset, first);
+            std::memcpy(static_cast<char *>(data) + first, m_buffer, size - first);
+        }
 
-    void threadCallBack(int x, std::string str)
-    {
-        std::cout << "Passed Number = " << x << std::endl;
-        std::cout << "Passed String = " << str << std::endl;
-    }
+    public:
+        explicit Ring(std::uint32_t threadIndex) : m_head(0), m_tail(0), m_closed(false), m_threadIndex(threadIndex) {}
 
-    void passArgumentsbyValue()
-    {
-        std::cout << "+++++++" << __FUNCTION__ << "+++++++\n";
-        int x = 10;
-        std::string str = "Sample String";
-        std::thread threadObj(threadCallBack, x, str);
-        threadObj.join();
-    }
-    /*How not to pass arguments to threads :*/
+        static size_t maxText()
+        {
+            return Capacity / 4;
+        }
 
-    //Dont pass addresses of variables from local stack to threads callback function.
-    //Because it might be possible that local variable in Thread 1 goes out of scope
-    //but Thread 2 is still trying to access it through its address.
+        // Called by the owning thread only, returns false if there is no room right now
+        bool tryPush(const char * text, std::uint32_t size, std::uint64_t timeNs)
+        {
+            size_t tail = m_tail.load(std::memory_order_relaxed);
+            size_t recordSize = padded(sizeof(RecordHeader) + size);
+            if (tail + recordSize - m_head.load(std::memory_order_acquire) > Capacity)
+                return false;
+            RecordHeader header = { timeNs, size, m_threadIndex };
+            copyIn(tail, &header, sizeof(header));
+            copyIn(tail + sizeof(header), text, size);
+            m_tail.store(tail + recordSize, std::memory_order_release);
+            return true;
+        }
 
-    void threadCallback(int const & x)
-    {
-        int &y = const_cast<int &>(x);
-        y++;
-        std::cout << "Inside Thread x = " << x << std::endl;
-    }
+        // Called by the logger thread only, onRecord(header, text) gets every record that is in the ring now.
+        // The records stay in the ring until all of them were handed out.
+        template <typename Fn>
+        size_t drain(std::vector<char> & scratch, Fn onRecord)
+        {
+            size_t head = m_head.load(std::memory_order_relaxed);
+            size_t tail = m_tail.load(std::memory_order_acquire);
+            size_t count = 0;
+            for (size_t position = head; position != tail; ++count)
+            {
+                RecordHeader header;
+                copyOut(position, &header, sizeof(header));
+                scratch.resize(header.size);
+                copyOut(position + sizeof(header), scratch.data(), header.size);
+                onRecord(header, scratch.data());
+                position += padded(sizeof(header) + header.size);
+            }
+            m_head.store(tail, std::memory_order_release);
+            return count;
+        }
 
-    void passArgumentsByReferences()
-    {
-        std::cout << "+++++++ " << __FUNCTION__ << " +++++++\n";
-        int x = 9;
-        std::cout << "In Main Thread: Before Thread Start x = " << x << std::endl;
-        std::thread threadObj(threadCallback, std::ref(x));
-        threadObj.join();
-        std::cout << "In Main Thread: After Thread Joins x = " << x << std::endl;
-        return;
-    }
+        void close()
+        {
+            m_closed.store(true, std::memory_order_release);
+        }
 
-    class DummyClass {
-    public:
-        DummyClass()
-        {}
-        DummyClass(const DummyClass &obj)
-        {}
-        void sampleMemberFunction(int x)
+        bool isClosed() const
         {
-            std::cout << "Inside sampleMemberFunction x = " << x << std::endl;
+            return m_closed.load(std::memory_order_acquire);
         }
     };
-    void assigningPointerToMemberFunctionAsThreadFunction()
+
+    class Logger
     {
-        std::cout << "+++++++ " << __FUNCTION__ << " +++++++\n";
-        DummyClass dummyobj;
-        int x = 10;
-        std::thread threadObj(&DummyClass::sampleMemberFunction, &dummyobj, x);
-        threadObj.join();
-        return;
-    }
-}
+        struct Record {
+            std::uint64_t timeNs;
+            std::uint32_t threadIndex;
+            size_t offset;
+            size_t size;
+        };
 
-namespace dataSharingAndRaceConditions {
-    // What is a Race Condition?
-    // When two or more threads perform a set of operations in parallel, 
-    // that access the same memory location.Also, one or more thread out of them modifies the data in that memory location, 
-    // then this can lead to an unexpected results some times.
-    // This is called race condition.
+        // The ring of a thread is closed by this when the thread ends
+        struct ThreadRing {
+            Logger * owner = nullptr;
+            std::shared_ptr<Ring> ring;
+            ~ThreadRing()
+            {
+                if (ring)
+                    ring->close();
+            }
+        };
 
-    class Wallet {
-        int mMoney;
-    public:
-        Wallet() :mMoney(0) {}
-        int getMoney() { return mMoney; }
-        void addMoney(int money)
+        enum { BatchSize = 1 << 16 };
+
+        const int m_fd;
+        const Clock::time_point m_start;
+        std::mutex m_mutex;
+        std::condition_variable m_condVar;
+        std::vector<std::shared_ptr<Ring>> m_rings;
+        std::atomic<unsigned> m_ringsVersion;
+        std::atomic<std::uint32_t> m_nextThreadIndex;
+        std::atomic<bool> m_prefix;
+        std::atomic<bool> m_ringFull;
+        unsigned long long m_flushRequested;
+        unsigned long long m_flushDone;
+        bool m_done;
+        std::thread m_thread;
+
+        void writeAll(std::string & batch)
         {
-            std::cout << __FUNCTION__ << "\n";
-            for (int i = 0; i < money; ++i)
+            // Whatever was printed with printf / std::cout before must come out first
+            std::fflush(stdout);
+            const char * data = batch.data();
+            size_t left = batch.size();
+            while (left > 0)
             {
-                mMoney++;
+                ssize_t written = ::write(m_fd, data, left);
+                if (written < 0 && errno == EINTR)
+                    continue;
+                if (written <= 0)
+                    break;
+                data += written;
+                left -= written;
             }
+            batch.clear();
         }
-    };
 
-    int testMultithreadedWallet()
-    {
-        Wallet walletObj;
-        std::vector<std::thread> threads;
+        std::uint64_t nowNs() const
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_start).count();
+        }
 
-        for (int i =0; i < 10; ++i)
+        void format(std::string & batch, const Record & record, const std::string & text)
         {
-            threads.push_back(std::thread(&Wallet::addMoney, &walletObj, 1000));
+            if (m_prefix.load(std::memory_order_relaxed))
+            {
+                char prefix[48];
+                int size = std::snprintf(prefix, sizeof(prefix), "[%10.3f ms t%u] ", record.timeNs / 1e6, record.threadIndex);
+                batch.append(prefix, size);
+            }
+            batch.append(text, record.offset, record.size);
+            batch.push_back('\n');
         }
 
-        for (int i = 0; i < threads.size(); ++i)
+        void run()
         {
-            threads.at(i).join();
+            std::vector<std::shared_ptr<Ring>> rings;
+            unsigned ringsVersion = ~0u;
+            std::vector<Record> records;
+            std::vector<char> scratch;
+            std::string text;
+            std::vector<Record> pendingRecords;
+            std::string pendingText;
+            std::string batch;
+            batch.reserve(2 * BatchSize);
+
+            while (true)
+            {
+                unsigned long long flushRequested;
+                bool done;
+                std::uint64_t watermark;
+                {
+                    std::lock_guard<std::mutex> guard(m_mutex);
+                    // Taken before the list of rings, a ring that isn't in the list yet only has newer lines
+                    watermark = nowNs();
+                    if (ringsVersion != m_ringsVersion.load())
+                    {
+                        rings = m_rings;
+                        ringsVersion = m_ringsVersion.load();
+                    }
+                    flushRequested = m_flushRequested;
+                    done = m_done;
+                }
+
+                // Lines of different threads are put in time order. The rings are drained one after the other,
+                // so a line can reach a ring that was drained already while a later line of another thread
+                // reaches a ring that is drained after it. Only the lines older than the start of the pass are written
+                // (watermark), the newer ones wait for the next pass. A line that was logged before another one
+                // (before a join(), an unlock(), ...) was in its ring before the pass started, so it can't come out after it.
+                // Lines of threads that don't wait for each other come out in the order of their times.
+                std::vector<Ring *> finished;
+                for (auto & ring : rings)
+                {
+                    bool closed = ring->isClosed();
+                    ring->drain(scratch, [&](const RecordHeader & header, const char * data) {
+                        records.push_back({ header.timeNs, header.threadIndex, text.size(), header.size });
+                        text.append(data, header.size);
+                    });
+                    if (closed)
+                        finished.push_back(ring.get());
+                }
+                std::stable_sort(records.begin(), records.end(), [](const Record & a, const Record & b) {
+                    return a.timeNs < b.timeNs;
+                });
+                auto newer = std::partition_point(records.begin(), records.end(), [&](const Record & record) {
+                    return record.timeNs < watermark;
+                });
+                for (auto record = records.begin(); record != newer; ++record)
+                {
+                    format(batch, *record, text);
+                    if (batch.size() >= BatchSize)
+                        writeAll(batch);
+                }
+                if (!batch.empty())
+                    writeAll(batch);
+                bool idle = records.empty();
+
+                // The newer lines are the first ones of the next pass
+                pendingRecords.clear();
+                pendingText.clear();
+                for (auto record = newer; record != records.end(); ++record)
+                {
+                    pendingRecords.push_back({ record->timeNs, record->threadIndex, pendingText.size(), record->size });
+                    pendingText.append(text, record->offset, record->size);
+                }
+                records.swap(pendingRecords);
+                text.swap(pendingText);
+
+                std::unique_lock<std::mutex> mlock(m_mutex);
+                if (!finished.empty())
+                {
+                    // Nothing can be added to a closed ring, it was drained above for the last time
+                    m_rings.erase(std::remove_if(m_rings.begin(), m_rings.end(), [&](const std::shared_ptr<Ring> & ring) {
+                        return std::find(finished.begin(), finished.end(), ring.get()) != finished.end();
+                    }), m_rings.end());
+                    m_ringsVersion++;
+                }
+                if (m_flushDone != flushRequested)
+                {
+                    m_flushDone = flushRequested;
+                    m_condVar.notify_all();
+                }
+                if (idle)
+                {
+                    if (done)
+                        break;
+                    // The threads never signal new lines, that would cost them a system call.
+                    // Lines wait at most 1 ms, flush() and a full ring wake the logger at once.
+                    m_condVar.wait_for(mlock, std::chrono::milliseconds(1), [&]() {
+                        return m_done || m_flushRequested != flushRequested || m_ringFull.exchange(false);
+                    });
+                }
+            }
         }
-        return walletObj.getMoney();
-    }
 
-    void practicalExampleOfRaceCondition()
-    {
-        std::cout << "+++++++ " << __FUNCTION__ << " +++++++\n";
-        int val = testMultithreadedWallet();
-        for (int k = 0; k < 100000; k++)
+        Ring & ringOfThisThread()
         {
-            if (val != 10000)
+            thread_local ThreadRing threadRing;
+            if (threadRing.owner != this)
             {
-                std::cout << "Error at count = " << k << " Money in Wallet = " << val << std::endl;
+                if (threadRing.ring)
+                    threadRing.ring->close();
+                threadRing.ring = std::make_shared<Ring>(m_nextThreadIndex++);
+                threadRing.owner = this;
+                std::lock_guard<std::mutex> guard(m_mutex);
+                m_rings.push_back(threadRing.ring);
+                m_ringsVersion++;
             }
+            return *threadRing.ring;
         }
-        return;
-    }
-}
 
-namespace usingMutexToFixRaceConditions {
-    //  To fix race conditions in multi - threaded environment we need mutex 
-    //  i.e.each thread needs to lock a mutex before modifying or reading the shared data and 
-    //  after modifying the data each thread should unlock the mutex.
-    class Wallet
-    {
-        int mMoney;
-        std::mutex mutex;
     public:
-        Wallet() :mMoney(0) {}
-        int getMoney() { return mMoney; }
-        void addMoney(int money)
+        explicit Logger(int fd = STDOUT_FILENO)
+            : m_fd(fd), m_start(Clock::now()), m_ringsVersion(0), m_nextThreadIndex(0), m_prefix(false), m_ringFull(false),
+              m_flushRequested(0), m_flushDone(0), m_done(false)
+        {
+            m_thread = std::thread(&Logger::run, this);
+        }
+
+        Logger(const Logger &) = delete;
+        Logger & operator=(const Logger &) = delete;
+
+        // Everything logged before is written out
+        ~Logger()
         {
-            mutex.lock();
-            for (int i = 0; i < money; ++i)
             {
-                mMoney++;
+                std::lock_guard<std::mutex> guard(m_mutex);
+                m_done = true;
             }
-            mutex.unlock();
+            m_condVar.notify_all();
+            m_thread.join();
         }
-    };
 
-    int testMultithreadedWallet()
-    {
-        Wallet walletObject;
-        std::vector<std::thread> threads;
-        for (int i = 0; i < 5; ++i) {
-            threads.push_back(std::thread(&Wallet::addMoney, &walletObject, 1000));
+        static Logger & instance()
+        {
+            static Logger logger;
+            return logger;
         }
 
-        for (int i = 0; i < threads.size(); i++)
+        // Start every line with the time since the logger started and the index of the thread
+        void setPrefix(bool prefix)
         {
-            threads.at(i).join();
+            m_prefix.store(prefix);
         }
-        return walletObject.getMoney();
-    }
 
-    void test()
-    {
-        int val = 0;
-        for (int k = 0; k < 1000; k++)
+        void append(const char * text, size_t size)
         {
-            if ((val = testMultithreadedWallet()) != 5000)
+            std::uint64_t timeNs = nowNs();
+            Ring & ring = ringOfThisThread();
+            std::uint32_t length = static_cast<std::uint32_t>(std::min(size, Ring::maxText()));
+            while (!ring.tryPush(text, length, timeNs))
             {
-                std::cout << "Error at count = " << k << "  Money in Wallet = " << val << std::endl;
-                //break;
+                // Full, the logger has to catch up
+                m_ringFull.store(true);
+                m_condVar.notify_all();
+                std::this_thread::yield();
             }
         }
-        return;
-    }
 
-    // std::lock_guard :
-    // std::lock_guard is a class template, which implements the RAII for mutex.
-    //    It wraps the mutex inside its object and locks the attached mutex in its constructor.
-    // When its destructor is called it releases the mutex.
+        // Returns when all lines logged before the call are written
+        void flush()
+        {
+            std::unique_lock<std::mutex> mlock(m_mutex);
+            unsigned long long request = ++m_flushRequested;
+            m_condVar.notify_all();
+            m_condVar.wait(mlock, [&]() { return m_flushDone >= request; });
+        }
+    };
 
-    class Wallet2
+    // One line of text, handed to the logger when the statement ends
+    class LogLine
     {
-        int mMoney;
-        std::mutex mutex;
-    public:
-        Wallet2() :mMoney(0) {}
-        int getMoney() { return mMoney; }
-        void addMoney(int money)
+        enum { MaxLine = 512 };
+
+        // Lets the types that only have an operator<<(std::ostream &) write into the line buffer
+        class LineBuffer : public std::streambuf
         {
-            std::lock_guard<std::mutex> lockGuard(mutex);
-            // In constructor it locks the mutex
+        public:
+            LineBuffer(char * begin, char * end) { setp(begin, end); }
+            size_t size() const { return pptr() - pbase(); }
+        };
 
-            for (int i = 0; i < money; ++i)
-            {
-                // If some exception occurs at this
-                // poin then destructor of lockGuard
-                // will be called due to stack unwinding.
-                //
-                mMoney++;
-            }
-            // Once function exits, then destructor
-            // of lockGuard Object will be called.
-            // In destructor it unlocks the mutex.
-        }
-    };
-}
+        Logger & m_logger;
+        size_t m_size;
+        char m_text[MaxLine];
 
+        void append(const char * text, size_t size)
+        {
+            size = std::min(size, MaxLine - m_size);
+            std::memcpy(m_text + m_size, text, size);
+            m_size += size;
+        }
 
-namespace eventHandling {
-    // option 1 
-    // Make a Boolean global variable with default value false.
-    // Set its value to true in Thread 2 and Thread 1 will keep on checking its value 
-    // in loop and as soon as it becomes true Thread 1 will continue with processing of data.
-    class Application {
-        std::mutex m_mutex;
-        bool m_bDataloaded;
     public:
-        Application() {
-            m_bDataloaded = false;
+        explicit LogLine(Logger & logger) : m_logger(logger), m_size(0) {}
+        LogLine(const LogLine &) = delete;
+        LogLine & operator=(const LogLine &) = delete;
+
+        ~LogLine()
+        {
+            m_logger.append(m_text, m_size);
         }
-        void loadData()
+
+        LogLine & operator<<(const char * text)
         {
-            //Make this thread sleep for 1 Second
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-            std::cout << "Loading Data from XML\n";
+            append(text, std::strlen(text));
+            return *this;
+        }
 
-            // Lock the data structure
-            std::lock_guard<std::mutex> guard(m_mutex);
+        LogLine & operator<<(const std::string & text)
+        {
+            append(text.data(), text.size());
+            return *this;
+        }
 
-            //Set the flag to true, means data is loaded
-            m_bDataloaded = true;
+        LogLine & operator<<(char c)
+        {
+            append(&c, 1);
+            return *this;
         }
 
-        void mainTask()
+        LogLine & operator<<(double value)
         {
-            std::cout << "Do something handshaking\n";
+            char text[32];
+            append(text, std::snprintf(text, sizeof(text), "%g", value));
+            return *this;
+        }
 
-            //Acquire the lock
-            m_mutex.lock();
-            //Check if flag is set to true or not
-            while (m_bDataloaded != true)
-            {
-                //Release the lock
-                m_mutex.unlock();
-                //sleep for 100 milli seconds
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                //Acquire the lock
-                m_mutex.lock();
-            }
-            //Release the lock
-            m_mutex.unlock();
-            //Do processing on loaded data
-            std::cout << "Do processing  on loaded data\n";
+        template <typename T>
+        typename std::enable_if<std::is_integral<T>::value, LogLine &>::type operator<<(T value)
+        {
+            char text[24];
+            append(text, std::to_chars(text, text + sizeof(text), value).ptr - text);
+            return *this;
+        }
 
+        template <typename T>
+        typename std::enable_if<!std::is_arithmetic<T>::value, LogLine &>::type operator<<(const T & value)
+        {
+            LineBuffer buffer(m_text + m_size, m_text + MaxLine);
+            std::ostream stream(&buffer);
+            stream << value;
+            m_size += buffer.size();
+            return *this;
         }
     };
 
-    void options1Test()
+    inline LogLine log(Logger & logger = Logger::instance())
     {
-        Application app;
-        
-        std::thread thread_1(&Application::mainTask, &app);
-        std::thread thread_2(&Application::loadData, &app);
+        return LogLine(logger);
+    }
 
-        thread_2.join();
-        thread_1.join();
+    // The same lines from threadCount threads, once with std::cout << ... << std::endl, once with the logger.
+    // stdout is sent to a temporary file meanwhile, like a program whose output is redirected to a log file.
+    void benchmarkAgainstCout()
+    {
+        const int linesPerThread = 50000;
+        Logger & logger = Logger::instance();
+        std::cout << "lines/s with threads writing " << linesPerThread << " lines each" << std::endl;
+        std::cout << "threads       std::cout      asyncLogging" << std::endl;
+
+        for (int threadCount : { 1, 2, 4, 8, 16 })
+        {
+            double rates[2];
+            for (int useLogger = 0; useLogger < 2; ++useLogger)
+            {
+                std::cout.flush();
+                std::fflush(stdout);
+                logger.flush();
+                int savedStdout = dup(STDOUT_FILENO);
+                char fileName[] = "/tmp/asyncLoggingXXXXXX";
+                int file = mkstemp(fileName);
+                dup2(file, STDOUT_FILENO);
+
+                auto start = Clock::now();
+                std::vector<std::thread> threads;
+                for (int t = 0; t < threadCount; ++t)
+                {
+                    threads.emplace_back([&, t]() {
+                        for (int i = 0; i < linesPerThread; ++i)
+                        {
+                            if (useLogger)
+                                log(logger) << "Worker " << t << " wrote line " << i;
+                            else
+                                std::cout << "Worker " << t << " wrote line " << i << std::endl;
+                        }
+                    });
+                }
+                for (auto & thread : threads)
+                    thread.join();
+                if (useLogger)
+                    logger.flush();
+                std::cout.flush();
+                double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+                rates[useLogger] = threadCount * linesPerThread / seconds;
+
+                dup2(savedStdout, STDOUT_FILENO);
+                ::close(savedStdout);
+                ::close(file);
+                ::unlink(fileName);
+            }
+            std::cout << std::setw(7) << threadCount << std::setw(15) << static_cast<long long>(rates[0])
+                      << std::setw(18) << static_cast<long long>(rates[1]) << std::endl;
+        }
+    }
+}
+
+namespace smallBufferTask {
+    // std::function<> and std::packaged_task<> store the callable on the heap (std::function<> only
+    // skips that for very small callables), so every task we create means a new / delete pair.
+
+    // Task<> is a move-only callable wrapper with an inline buffer of 'Capacity' bytes.
+    // A callable that fits (e.g. a lambda capturing a few values, or std::bind() of a function and its arguments)
+    // is moved right into the buffer, only bigger callables go to the heap.
+    template <typename Signature, size_t Capacity = 64> class Task;
+
+    template <typename R, typename... Args, size_t Capacity>
+    class Task<R(Args...), Capacity> {
+        enum class Operation { MoveTo, Destroy };
+        typedef R(*Invoker)(void * storage, Args &&... args);
+        typedef void(*Manager)(Operation operation, void * storage, void * destination);
+
+        typename std::aligned_storage<Capacity, alignof(std::max_align_t)>::type m_storage;
+        Invoker m_invoke;
+        Manager m_manage;
+
+        template <typename Fn>
+        struct Inline {
+            static R invoke(void * storage, Args &&... args)
+            {
+                return (*static_cast<Fn *>(storage))(std::forward<Args>(args)...);
+            }
+            static void manage(Operation operation, void * storage, void * destination)
+            {
+                Fn * fn = static_cast<Fn *>(storage);
+                if (operation == Operation::MoveTo)
+                    new (destination) Fn(std::move(*fn));
+                fn->~Fn();
+            }
+        };
+
+        template <typename Fn>
+        struct OnHeap {
+            static R invoke(void * storage, Args &&... args)
+            {
+                return (**static_cast<Fn **>(storage))(std::forward<Args>(args)...);
+            }
+            static void manage(Operation operation, void * storage, void * destination)
+            {
+                Fn ** fn = static_cast<Fn **>(storage);
+                if (operation == Operation::MoveTo)
+                    *static_cast<Fn **>(destination) = *fn;
+                else
+                    delete *fn;
+            }
+        };
+
+        template <typename Fn, typename F>
+        void store(F && fn, std::true_type /*fits inline*/)
+        {
+            new (&m_storage) Fn(std::forward<F>(fn));
+            m_invoke = &Inline<Fn>::invoke;
+            m_manage = &Inline<Fn>::manage;
+        }
+
+        template <typename Fn, typename F>
+        void store(F && fn, std::false_type /*fits inline*/)
+        {
+            *reinterpret_cast<Fn **>(&m_storage) = new Fn(std::forward<F>(fn));
+            m_invoke = &OnHeap<Fn>::invoke;
+            m_manage = &OnHeap<Fn>::manage;
+        }
+
+        void moveFrom(Task & obj) noexcept
+        {
+            m_invoke = obj.m_invoke;
+            m_manage = obj.m_manage;
+            if (m_manage)
+                m_manage(Operation::MoveTo, &obj.m_storage, &m_storage);
+            obj.m_invoke = nullptr;
+            obj.m_manage = nullptr;
+        }
+
+        void destroy() noexcept
+        {
+            if (m_manage)
+                m_manage(Operation::Destroy, &m_storage, nullptr);
+            m_invoke = nullptr;
+            m_manage = nullptr;
+        }
+
+    public:
+        template <typename Fn>
+        static constexpr bool fitsInline()
+        {
+            return sizeof(Fn) <= Capacity && alignof(Fn) <= alignof(std::max_align_t)
+                && std::is_nothrow_move_constructible<Fn>::value;
+        }
+
+        Task() : m_invoke(nullptr), m_manage(nullptr) {}
+
+        template <typename F, typename Fn = typename std::decay<F>::type,
+            typename = typename std::enable_if<!std::is_same<Fn, Task>::value>::type>
+        Task(F && fn)
+        {
+            store<Fn>(std::forward<F>(fn), std::integral_constant<bool, fitsInline<Fn>()>());
+        }
+
+        Task(Task && obj) noexcept { moveFrom(obj); }
+
+        Task & operator=(Task && obj) noexcept
+        {
+            if (this != &obj)
+            {
+                destroy();
+                moveFrom(obj);
+            }
+            return *this;
+        }
+
+        Task(const Task &) = delete;
+        Task & operator=(const Task &) = delete;
+
+        ~Task() { destroy(); }
+
+        explicit operator bool() const { return m_invoke != nullptr; }
+
+        R operator()(Args... args)
+        {
+            return m_invoke(&m_storage, std::forward<Args>(args)...);
+        }
+    };
+
+    // Binds a callback and its arguments into a Task<R()>, like std::thread does with its arguments
+    template <typename Fn, typename... Args>
+    auto makeTask(Fn && fn, Args &&... args)
+    {
+        auto boundTask = std::bind(std::forward<Fn>(fn), std::forward<Args>(args)...);
+        return Task<decltype(boundTask())()>(std::move(boundTask));
+    }
+}
+
+namespace threadPlacement {
+    // By default the OS decides on which CPU a thread runs, and may move it around.
+    // On a machine with several sockets / NUMA nodes, threads that share data should sit close together,
+    // while threads that work on their own data should be spread out to get more caches and memory bandwidth.
+
+    // Topology reads from /sys/devices/system/cpu and /sys/devices/system/node which CPU belongs to which
+    // core, socket (package) and NUMA node. AffinityPolicy maps the n-th thread to a CPU,
+    //    1.) Compact  - fill one core, then the next core of the same node, then the next node.
+    //    2.) Scatter  - one thread per node in turn, using separate cores before hyperthread siblings.
+    //    3.) Explicit - a given list of CPUs, used round robin.
+    //    4.) None     - leave it to the OS.
+    struct Cpu {
+        int id;
+        int core;
+        int package;
+        int node;
+        int siblingRank;    // 0 for the first hardware thread of a core, 1 for its hyperthread sibling, ...
+    };
+
+    // Parses the kernel's list format, e.g. "0-3,8,10-11"
+    std::vector<int> parseCpuList(const std::string & list)
+    {
+        std::vector<int> result;
+        std::stringstream stream(list);
+        std::string range;
+        while (std::getline(stream, range, ','))
+        {
+            if (range.empty() || !isdigit(static_cast<unsigned char>(range[0])))
+                continue;
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu)
+                result.push_back(cpu);
+        }
+        return result;
+    }
+
+    std::string readFirstLine(const std::string & path)
+    {
+        std::ifstream file(path);
+        std::string line;
+        std::getline(file, line);
+        return line;
+    }
+
+    class Topology {
+        std::vector<Cpu> m_cpus;
+
+        void read()
+        {
+            std::vector<int> online = parseCpuList(readFirstLine("/sys/devices/system/cpu/online"));
+#ifdef __linux__
+            // Only CPUs we are allowed to run on, e.g. inside a container or under taskset
+            cpu_set_t allowed;
+            CPU_ZERO(&allowed);
+            if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+            {
+                online.erase(std::remove_if(online.begin(), online.end(),
+                    [&allowed](int cpu) { return cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed); }), online.end());
+            }
+#endif
+            std::map<int, int> nodeOfCpu;
+            for (int node : parseCpuList(readFirstLine("/sys/devices/system/node/online")))
+            {
+                for (int cpu : parseCpuList(readFirstLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist")))
+                    nodeOfCpu[cpu] = node;
+            }
+
+            std::map<std::pair<int, int>, int> threadsPerCore;
+            for (int id : online)
+            {
+                std::string topology = "/sys/devices/system/cpu/cpu" + std::to_string(id) + "/topology/";
+                std::string core = readFirstLine(topology + "core_id");
+                std::string package = readFirstLine(topology + "physical_package_id");
+                Cpu cpu;
+                cpu.id = id;
+                cpu.core = core.empty() ? id : std::stoi(core);
+                cpu.package = package.empty() ? 0 : std::stoi(package);
+                cpu.node = nodeOfCpu.count(id) ? nodeOfCpu[id] : 0;
+                cpu.siblingRank = threadsPerCore[std::make_pair(cpu.package, cpu.core)]++;
+                m_cpus.push_back(cpu);
+            }
+
+            // Without /sys pretend every hardware thread is its own core on node 0
+            if (m_cpus.empty())
+            {
+                for (unsigned id = 0; id < std::max(1u, std::thread::hardware_concurrency()); ++id)
+                    m_cpus.push_back(Cpu{ static_cast<int>(id), static_cast<int>(id), 0, 0, 0 });
+            }
+        }
+
+    public:
+        Topology() { read(); }
+
+        const std::vector<Cpu> & cpus() const { return m_cpus; }
+
+        int nodeCount() const
+        {
+            std::vector<int> nodes;
+            for (const Cpu & cpu : m_cpus)
+                nodes.push_back(cpu.node);
+            std::sort(nodes.begin(), nodes.end());
+            return static_cast<int>(std::unique(nodes.begin(), nodes.end()) - nodes.begin());
+        }
+
+        void print(std::ostream & out) const
+        {
+            out << "CPUs = " << m_cpus.size() << "  NUMA nodes = " << nodeCount() << "\n";
+            for (const Cpu & cpu : m_cpus)
+                out << "    cpu " << cpu.id << "  node " << cpu.node << "  package " << cpu.package
+                    << "  core " << cpu.core << "  thread " << cpu.siblingRank << "\n";
+        }
+
+        static const Topology & instance()
+        {
+            static Topology topology;
+            return topology;
+        }
+    };
+
+    class AffinityPolicy {
+    public:
+        enum Kind { None, Compact, Scatter, Explicit };
+
+    private:
+        Kind m_kind;
+        std::vector<int> m_order;   // CPU ids in the order threads are placed on them
+
+        AffinityPolicy(Kind kind, std::vector<int> order) : m_kind(kind), m_order(std::move(order)) {}
+
+        template <typename Less>
+        static std::vector<int> sortedCpus(Less less)
+        {
+            std::vector<Cpu> cpus = Topology::instance().cpus();
+            std::sort(cpus.begin(), cpus.end(), less);
+            std::vector<int> order;
+            for (const Cpu & cpu : cpus)
+                order.push_back(cpu.id);
+            return order;
+        }
+
+    public:
+        AffinityPolicy() : m_kind(None) {}
+
+        static AffinityPolicy none() { return AffinityPolicy(); }
+
+        static AffinityPolicy compact()
+        {
+            return AffinityPolicy(Compact, sortedCpus([](const Cpu & a, const Cpu & b) {
+                return std::tie(a.node, a.package, a.core, a.siblingRank) < std::tie(b.node, b.package, b.core, b.siblingRank);
+            }));
+        }
+
+        static AffinityPolicy scatter()
+        {
+            // The n-th core of every node comes before the (n+1)-th core of any node
+            std::map<std::pair<int, int>, int> coreRank;
+            std::map<int, int> coresPerNode;
+            std::vector<Cpu> cpus = Topology::instance().cpus();
+            std::sort(cpus.begin(), cpus.end(), [](const Cpu & a, const Cpu & b) {
+                return std::tie(a.node, a.package, a.core) < std::tie(b.node, b.package, b.core);
+            });
+            for (const Cpu & cpu : cpus)
+            {
+                auto key = std::make_pair(cpu.package, cpu.core);
+                if (!coreRank.count(key))
+                    coreRank[key] = coresPerNode[cpu.node]++;
+            }
+            return AffinityPolicy(Scatter, sortedCpus([&coreRank](const Cpu & a, const Cpu & b) {
+                int rankA = coreRank[std::make_pair(a.package, a.core)];
+                int rankB = coreRank[std::make_pair(b.package, b.core)];
+                return std::tie(a.siblingRank, rankA, a.node) < std::tie(b.siblingRank, rankB, b.node);
+            }));
+        }
+
+        static AffinityPolicy explicitCpus(std::vector<int> cpus)
+        {
+            return AffinityPolicy(Explicit, std::move(cpus));
+        }
+
+        Kind kind() const { return m_kind; }
+
+        // CPU for the n-th thread, or -1 to let the OS decide
+        int cpuFor(size_t threadIndex) const
+        {
+            if (m_kind == None || m_order.empty())
+                return -1;
+            return m_order[threadIndex % m_order.size()];
+        }
+
+        const char * name() const
+        {
+            const char * names[] = { "none", "compact", "scatter", "explicit" };
+            return names[m_kind];
+        }
+    };
+
+    // Pins the calling thread to one CPU, returns false if that is not possible
+    bool pinCurrentThread(int cpu)
+    {
+#ifdef __linux__
+        if (cpu < 0 || cpu >= CPU_SETSIZE)
+            return false;
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+        return false;
+#endif
+    }
+
+    // Like std::thread(fn, args...), but the new thread first moves itself to the CPU
+    // the policy gives for 'threadIndex', so it never runs anywhere else.
+    template <typename Fn, typename... Args>
+    std::thread launchThread(const AffinityPolicy & policy, size_t threadIndex, Fn && fn, Args &&... args)
+    {
+        int cpu = policy.cpuFor(threadIndex);
+        auto boundTask = std::bind(std::forward<Fn>(fn), std::forward<Args>(args)...);
+        return std::thread([cpu](decltype(boundTask) task) {
+            if (cpu >= 0)
+                pinCurrentThread(cpu);
+            task();
+        }, std::move(boundTask));
+    }
+}
+
+namespace workStealingThreadPool {
+    // Creating a new std::thread for every small piece of work is expensive:
+    // each thread needs a new stack, a system call to start it and another one to join it.
+    // When the work itself is tiny, most of the time is spent creating and destroying threads.
+
+    // A thread pool creates a fixed number of worker threads once and then feeds tasks to them.
+    // In a work-stealing pool every worker owns its own deque of tasks,
+    //    1.) A worker pushes and pops its own tasks at the back of its deque (most recent task first, data is still in cache).
+    //    2.) A worker with an empty deque steals the oldest task from the front of another worker's deque.
+    // So workers don't fight over one shared queue and the load still gets balanced.
+    class ThreadPool {
+    public:
+        // Tasks are kept in small buffer Tasks, so queuing a small closure doesn't allocate
+        typedef smallBufferTask::Task<void(), 128> Job;
+
+    private:
+        // Double ended queue in a ring buffer that only ever grows.
+        // std::deque<> would allocate and free a block every few tasks.
+        struct WorkQueue {
+            std::mutex mutex;
+            std::vector<Job> ring;
+            size_t head = 0;
+            size_t count = 0;
+
+            bool empty() const { return count == 0; }
+
+            void push_back(Job job)
+            {
+                if (count == ring.size())
+                {
+                    std::vector<Job> bigger(ring.empty() ? 64 : ring.size() * 2);
+                    for (size_t i = 0; i < count; ++i)
+                        bigger[i] = std::move(ring[(head + i) % ring.size()]);
+                    ring.swap(bigger);
+                    head = 0;
+                }
+                ring[(head + count) % ring.size()] = std::move(job);
+                ++count;
+            }
+
+            Job pop_back()
+            {
+                --count;
+                return std::move(ring[(head + count) % ring.size()]);
+            }
+
+            Job pop_front()
+            {
+                Job job = std::move(ring[head]);
+                head = (head + 1) % ring.size();
+                --count;
+                return job;
+            }
+        };
+
+        std::vector<std::unique_ptr<WorkQueue>> m_queues;
+        std::vector<std::thread> m_workers;
+        std::mutex m_sleepMutex;
+        std::condition_variable m_sleepCondVar;
+        std::atomic<size_t> m_pending;
+        std::atomic<int> m_idle;
+        std::atomic<unsigned> m_nextQueue;
+        bool m_done;
+
+        // Index of the worker running on the current thread, or -1 if it is not one of our workers
+        static int & currentWorker(const ThreadPool * pool)
+        {
+            thread_local const ThreadPool * owner = nullptr;
+            thread_local int index = -1;
+            if (owner != pool)
+            {
+                owner = pool;
+                index = -1;
+            }
+            return index;
+        }
+
+        void post(Job task)
+        {
+            // Count the task before it becomes visible, so a worker never sees a task without a count
+            m_pending.fetch_add(1);
+
+            int self = currentWorker(this);
+            unsigned index = self >= 0 ? self : m_nextQueue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+            {
+                std::lock_guard<std::mutex> guard(m_queues[index]->mutex);
+                m_queues[index]->push_back(std::move(task));
+            }
+
+            // Only pay for the notification when somebody is actually sleeping
+            if (m_idle.load() > 0)
+            {
+                std::lock_guard<std::mutex> guard(m_sleepMutex);
+                m_sleepCondVar.notify_one();
+            }
+        }
+
+        bool popLocal(unsigned index, Job & task)
+        {
+            std::lock_guard<std::mutex> guard(m_queues[index]->mutex);
+            if (m_queues[index]->empty())
+                return false;
+            task = m_queues[index]->pop_back();
+            return true;
+        }
+
+        bool steal(unsigned thief, Job & task)
+        {
+            for (unsigned i = 1; i < m_queues.size(); ++i)
+            {
+                WorkQueue & victim = *m_queues[(thief + i) % m_queues.size()];
+                std::lock_guard<std::mutex> guard(victim.mutex);
+                if (!victim.empty())
+                {
+                    task = victim.pop_front();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void workerLoop(unsigned index)
+        {
+            currentWorker(this) = index;
+            Job task;
+            while (true)
+            {
+                if (popLocal(index, task) || steal(index, task))
+                {
+                    m_pending.fetch_sub(1);
+                    task();
+                    task = Job();
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> mlock(m_sleepMutex);
+                m_idle.fetch_add(1);
+                m_sleepCondVar.wait(mlock, [this] { return m_done || m_pending.load() > 0; });
+                m_idle.fetch_sub(1);
+                // Remaining tasks are still executed before the pool shuts down
+                if (m_done && m_pending.load() == 0)
+                    return;
+            }
+        }
+
+    public:
+        // 'placement' decides on which CPU every worker runs, see threadPlacement
+        explicit ThreadPool(unsigned threadCount = std::thread::hardware_concurrency(),
+            const threadPlacement::AffinityPolicy & placement = threadPlacement::AffinityPolicy::none())
+            : m_pending(0), m_idle(0), m_nextQueue(0), m_done(false)
+        {
+            if (threadCount == 0)
+                threadCount = 1;
+            for (unsigned i = 0; i < threadCount; ++i)
+                m_queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue));
+            for (unsigned i = 0; i < threadCount; ++i)
+                m_workers.push_back(threadPlacement::launchThread(placement, i, &ThreadPool::workerLoop, this, i));
+        }
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool & operator=(const ThreadPool &) = delete;
+
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> guard(m_sleepMutex);
+                m_done = true;
+            }
+            m_sleepCondVar.notify_all();
+            std::for_each(m_workers.begin(), m_workers.end(), std::mem_fn(&std::thread::join));
+        }
+
+        unsigned size() const
+        {
+            return static_cast<unsigned>(m_workers.size());
+        }
+
+        // Accepts the same callbacks as std::thread i.e. function pointer, function object,
+        // lambda or pointer to member function with its arguments.
+        // The returned std::future<> gives the return value or the exception thrown by the task.
+        template <typename Fn, typename... Args>
+        auto submit(Fn && fn, Args &&... args)
+        {
+            auto boundTask = std::bind(std::forward<Fn>(fn), std::forward<Args>(args)...);
+            typedef decltype(boundTask()) Result;
+
+            // The future needs the packaged_task<>'s shared state, so share it with the queued job
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::move(boundTask));
+            std::future<Result> result = task->get_future();
+            post([task]() { (*task)(); });
+            return result;
+        }
+
+        // Fire and forget, the job has to deliver its own result
+        void execute(Job job)
+        {
+            post(std::move(job));
+        }
+    };
+
+    // One pool shared by the examples, created on first use
+    ThreadPool & defaultPool()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    void benchmarkSpawnVsPool()
+    {
+        std::cout << "+++++++" << __FUNCTION__ << "+++++++\n";
+        ThreadPool & pool = defaultPool();
+        const int taskCounts[] = { 10, 1000, 100000 };
+
+        for (int taskCount : taskCounts)
+        {
+            std::atomic<int> counter(0);
+            auto tinyTask = [&counter]() { counter.fetch_add(1, std::memory_order_relaxed); };
+
+            // One std::thread per task. Threads are joined in batches so we don't keep
+            // 100k finished-but-not-joined threads (and their stacks) around at once.
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> threads;
+            for (int i = 0; i < taskCount; ++i)
+            {
+                threads.push_back(std::thread(tinyTask));
+                if (threads.size() == 1000)
+                {
+                    std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
+                    threads.clear();
+                }
+            }
+            std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
+            auto spawnTime = std::chrono::steady_clock::now() - start;
+
+            // Same tasks submitted to the pool
+            start = std::chrono::steady_clock::now();
+            std::vector<std::future<void>> results;
+            results.reserve(taskCount);
+            for (int i = 0; i < taskCount; ++i)
+                results.push_back(pool.submit(tinyTask));
+            std::for_each(results.begin(), results.end(), std::mem_fn(&std::future<void>::get));
+            auto poolTime = std::chrono::steady_clock::now() - start;
+
+            std::cout << "Tasks = " << taskCount
+                << "  spawn per task = " << std::chrono::duration_cast<std::chrono::microseconds>(spawnTime).count() << " us"
+                << "  pooled = " << std::chrono::duration_cast<std::chrono::microseconds>(poolTime).count() << " us"
+                << "  (" << pool.size() << " workers, counter = " << counter << ")\n";
+        }
+    }
+}
+
+namespace joiningAndDetachingThreads {
+    //  std::thread th(funcPtr);
+    //  th.join();
+    class WorkerThread {
+    public:
+        void operator()()
+        {
+            asyncLogging::log() << "Worker Thread " << std::this_thread::get_id() << " is Executing";
+        }
+    };
+
+    void joiningThreads()
+    {
+        asyncLogging::log() << "+++++++" << __FUNCTION__ << "+++++++";
+        // Instead of creating a std::thread per worker, submit the workers to the thread pool.
+        // The pool threads are created once and reused, see workStealingThreadPool.
+        workStealingThreadPool::ThreadPool & pool = workStealingThreadPool::defaultPool();
+        std::vector<std::future<void>> workerList;
+
+        for (int i = 0; i < 10; ++i)
+        {
+            workerList.push_back(pool.submit(WorkerThread()));
+        }
+
+        // Now wait for all the workers to finish i.e.
+        // Call get() function on each of the std::future object, like join() on a std::thread
+        asyncLogging::log() << "Wait for all the worker threads to finish";
+        std::for_each(workerList.begin(), workerList.end(), std::mem_fn(&std::future<void>::get));
+        asyncLogging::log() << "Exiting from Main Thread";
+    }
+
+    void detachingThreads()
+    {
+        asyncLogging::log() << "+++++++" << __FUNCTION__ << "+++++++";
+        // Case 1: Never call join() or detach() on std::thread object with no associated executing thread
+        // Detached threads are also called daemon / Background threads.  
+        // To detach a thread we need to call std::detach() function on std::thread object i.e.
+        // std::thread th(funcPtr);
+        // th.detach();
+        // After calling detach(), std::thread object is no longer associated with the actual thread of execution.
+        // before calling join() or detach() we should check if thread is join - able every time i.e. threadObj.joinable()
+
+        // Case 2 : Never forget to call either join or detach on a std::thread object with associated executing thread
+        std::thread threadObj(WorkerThread());
+        return;
+    }
+}
+
+namespace passArgumentsToThreads {
+    // By default all arguments are copied into the internal storage of new thread.
+
+    void threadCallBack(int x, std::string str)
+    {
+        asyncLogging::log() << "Passed Number = " << x;
+        asyncLogging::log() << "Passed String = " << str;
+    }
+
+    void passArgumentsbyValue()
+    {
+        asyncLogging::log() << "+++++++" << __FUNCTION__ << "+++++++";
+        int x = 10;
+        std::string str = "Sample String";
+        std::thread threadObj(threadCallBack, x, str);
+        threadObj.join();
+    }
+    /*How not to pass arguments to threads :*/
+
+    //Dont pass addresses of variables from local stack to threads callback function.
+    //Because it might be possible that local variable in Thread 1 goes out of scope
+    //but Thread 2 is still trying to access it through its address.
+
+    void threadCallback(int const & x)
+    {
+        int &y = const_cast<int &>(x);
+        y++;
+        asyncLogging::log() << "Inside Thread x = " << x;
+    }
+
+    void passArgumentsByReferences()
+    {
+        asyncLogging::log() << "+++++++ " << __FUNCTION__ << " +++++++";
+        int x = 9;
+        asyncLogging::log() << "In Main Thread: Before Thread Start x = " << x;
+        std::thread threadObj(threadCallback, std::ref(x));
+        threadObj.join();
+        asyncLogging::log() << "In Main Thread: After Thread Joins x = " << x;
+        return;
+    }
+
+    class DummyClass {
+    public:
+        DummyClass()
+        {}
+        DummyClass(const DummyClass &obj)
+        {}
+        void sampleMemberFunction(int x)
+        {
+            asyncLogging::log() << "Inside sampleMemberFunction x = " << x;
+        }
+    };
+    void assigningPointerToMemberFunctionAsThreadFunction()
+    {
+        asyncLogging::log() << "+++++++ " << __FUNCTION__ << " +++++++";
+        DummyClass dummyobj;
+        int x = 10;
+        std::thread threadObj(&DummyClass::sampleMemberFunction, &dummyobj, x);
+        threadObj.join();
+        return;
+    }
+}
+
+namespace mutexProfiling {
+    // How long do our threads wait for a mutex, and how long do they keep it?
+    // ProfiledMutex works like std::mutex, and additionally records for every lock() call site
+    //    1.) the acquire wait time, i.e. how long lock() was blocked,
+    //    2.) the hold time, i.e. the time between lock() and unlock(),
+    //    3.) whether the lock was contended, i.e. the mutex was already taken.
+    // Each thread writes into its own buffer, so recording never takes another lock.
+    // An uncontended lock() is one try_lock() and one clock read.
+    // report() prints a histogram per mutex, it is called automatically at exit.
+    enum { MaxCallSites = 64, BucketCount = 32 };
+
+    // Where lock() is called from, see MUTEX_CALL_SITE
+    struct CallSite {
+        const char * function;
+        int line;
+        int id;
+        CallSite() : function("unknown"), line(0), id(-1) {}
+        CallSite(const char * function, int line);
+    };
+
+    // One writer (the owning thread), so plain load + store instead of read-modify-write
+    struct Counter {
+        std::atomic<unsigned long long> value{ 0 };
+        void add(unsigned long long amount)
+        {
+            value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+        }
+        unsigned long long get() const { return value.load(std::memory_order_relaxed); }
+    };
+
+    struct SiteStats {
+        std::atomic<const char *> mutexName{ nullptr };
+        Counter acquisitions;
+        Counter contended;
+        Counter totalWaitNs;
+        Counter totalHoldNs;
+        Counter waitHistogram[BucketCount];     // bucket k counts times in [2^k, 2^(k+1)) ns, bucket 0 also counts 0
+        Counter holdHistogram[BucketCount];
+    };
+
+    struct ThreadBuffer {
+        SiteStats sites[MaxCallSites + 1];      // the last one collects lock() calls without a call site
+    };
+
+    class Profiler {
+        std::mutex m_mutex;
+        std::vector<std::shared_ptr<ThreadBuffer>> m_buffers;
+        std::vector<const CallSite *> m_sites;
+    public:
+        int registerSite(const CallSite * site)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            if (m_sites.size() >= MaxCallSites)
+                return MaxCallSites;
+            m_sites.push_back(site);
+            return static_cast<int>(m_sites.size() - 1);
+        }
+
+        // Buffers stay registered after their thread exits, so its records are still reported
+        std::shared_ptr<ThreadBuffer> registerThread()
+        {
+            std::shared_ptr<ThreadBuffer> buffer = std::make_shared<ThreadBuffer>();
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_buffers.push_back(buffer);
+            return buffer;
+        }
+
+        static void printHistogram(std::ostream & out, const char * title, const unsigned long long * histogram)
+        {
+            out << "    " << title << "\n";
+            for (int k = 0; k < BucketCount; ++k)
+            {
+                if (histogram[k])
+                    out << "        [" << (k ? 1ULL << k : 0) << ", " << (1ULL << (k + 1)) << ") ns : " << histogram[k] << "\n";
+            }
+        }
+
+        void report(std::ostream & out)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            if (m_buffers.empty())
+                return;
+            out << "+++++++ Mutex contention profile +++++++\n";
+
+            // Sum the per-thread buffers, then group the call sites by mutex
+            struct Totals {
+                unsigned long long acquisitions = 0, contended = 0, waitNs = 0, holdNs = 0;
+                unsigned long long waitHistogram[BucketCount] = {}, holdHistogram[BucketCount] = {};
+            };
+            std::map<std::string, std::vector<std::pair<int, Totals>>> byMutex;
+            for (int site = 0; site <= MaxCallSites; ++site)
+            {
+                Totals totals;
+                const char * mutexName = nullptr;
+                for (auto & buffer : m_buffers)
+                {
+                    const SiteStats & stats = buffer->sites[site];
+                    if (!stats.acquisitions.get())
+                        continue;
+                    mutexName = stats.mutexName.load(std::memory_order_relaxed);
+                    totals.acquisitions += stats.acquisitions.get();
+                    totals.contended += stats.contended.get();
+                    totals.waitNs += stats.totalWaitNs.get();
+                    totals.holdNs += stats.totalHoldNs.get();
+                    for (int k = 0; k < BucketCount; ++k)
+                    {
+                        totals.waitHistogram[k] += stats.waitHistogram[k].get();
+                        totals.holdHistogram[k] += stats.holdHistogram[k].get();
+                    }
+                }
+                if (totals.acquisitions)
+                    byMutex[mutexName ? mutexName : "unnamed"].push_back(std::make_pair(site, totals));
+            }
+
+            for (auto & entry : byMutex)
+            {
+                out << entry.first << "\n";
+                for (auto & siteTotals : entry.second)
+                {
+                    const Totals & totals = siteTotals.second;
+                    if (siteTotals.first < static_cast<int>(m_sites.size()))
+                        out << "  at " << m_sites[siteTotals.first]->function << ":" << m_sites[siteTotals.first]->line << "\n";
+                    else
+                        out << "  at unknown call site\n";
+                    out << "    acquisitions = " << totals.acquisitions
+                        << "  contended = " << totals.contended
+                        << " (" << 100.0 * totals.contended / totals.acquisitions << "%)"
+                        << "  total wait = " << totals.waitNs / 1000 << " us"
+                        << "  total hold = " << totals.holdNs / 1000 << " us\n";
+                    printHistogram(out, "wait time", totals.waitHistogram);
+                    printHistogram(out, "hold time", totals.holdHistogram);
+                }
+            }
+        }
+
+        ~Profiler()
+        {
+            report(std::cout);
+        }
+
+        static Profiler & instance()
+        {
+            static Profiler profiler;
+            return profiler;
+        }
+    };
+
+    CallSite::CallSite(const char * function, int line)
+        : function(function), line(line), id(Profiler::instance().registerSite(this))
+    {}
+
+    inline ThreadBuffer & threadBuffer()
+    {
+        thread_local std::shared_ptr<ThreadBuffer> buffer = Profiler::instance().registerThread();
+        return *buffer;
+    }
+
+    inline int bucketOf(unsigned long long ns)
+    {
+        int bucket = 0;
+        while (ns > 1 && bucket < BucketCount - 1)
+        {
+            ns >>= 1;
+            ++bucket;
+        }
+        return bucket;
+    }
+
+    void report()
+    {
+        Profiler::instance().report(std::cout);
+    }
+
+    class ProfiledMutex {
+        std::mutex m_mutex;
+        const char * m_name;
+        // Written by the owner only
+        std::chrono::steady_clock::time_point m_acquiredAt;
+        unsigned long long m_waitNs;
+        bool m_contended;
+        int m_siteId;
+
+    public:
+        explicit ProfiledMutex(const char * name = "unnamed") : m_name(name), m_waitNs(0), m_contended(false), m_siteId(MaxCallSites) {}
+        ProfiledMutex(const ProfiledMutex &) = delete;
+        ProfiledMutex & operator=(const ProfiledMutex &) = delete;
+
+        void lock(const CallSite & site = CallSite())
+        {
+            if (m_mutex.try_lock())
+            {
+                m_acquiredAt = std::chrono::steady_clock::now();
+                m_waitNs = 0;
+                m_contended = false;
+            }
+            else
+            {
+                auto start = std::chrono::steady_clock::now();
+                m_mutex.lock();
+                m_acquiredAt = std::chrono::steady_clock::now();
+                m_waitNs = std::chrono::duration_cast<std::chrono::nanoseconds>(m_acquiredAt - start).count();
+                m_contended = true;
+            }
+            m_siteId = site.id >= 0 ? site.id : MaxCallSites;
+        }
+
+        bool try_lock()
+        {
+            if (!m_mutex.try_lock())
+                return false;
+            m_acquiredAt = std::chrono::steady_clock::now();
+            m_waitNs = 0;
+            m_contended = false;
+            m_siteId = MaxCallSites;
+            return true;
+        }
+
+        void unlock()
+        {
+            // Copy what we need, then record after the mutex is released to keep the hold time short
+            unsigned long long holdNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - m_acquiredAt).count();
+            unsigned long long waitNs = m_waitNs;
+            bool contended = m_contended;
+            int siteId = m_siteId;
+            m_mutex.unlock();
+
+            SiteStats & stats = threadBuffer().sites[siteId];
+            if (!stats.acquisitions.get())
+                stats.mutexName.store(m_name, std::memory_order_relaxed);
+            stats.acquisitions.add(1);
+            stats.totalWaitNs.add(waitNs);
+            stats.totalHoldNs.add(holdNs);
+            stats.waitHistogram[bucketOf(waitNs)].add(1);
+            stats.holdHistogram[bucketOf(holdNs)].add(1);
+            if (contended)
+                stats.contended.add(1);
+        }
+    };
+
+    // std::mutex with the same interface, used when profiling is switched off
+    class PlainMutex : public std::mutex {
+    public:
+        explicit PlainMutex(const char * = nullptr) {}
+        using std::mutex::lock;
+        void lock(const CallSite &) { std::mutex::lock(); }
+    };
+
+    // std::lock_guard<> that passes the call site on to lock()
+    template <typename Mutex>
+    class LockGuard {
+        Mutex & m_mutex;
+    public:
+        LockGuard(Mutex & mutex, const CallSite & site) : m_mutex(mutex) { m_mutex.lock(site); }
+        ~LockGuard() { m_mutex.unlock(); }
+        LockGuard(const LockGuard &) = delete;
+        LockGuard & operator=(const LockGuard &) = delete;
+    };
+
+    template <int Line>
+    const CallSite & callSite(const char * function)
+    {
+        static CallSite site(function, Line);
+        return site;
+    }
+
+    // Build with -DPROFILE_MUTEXES=1 (cmake -DPROFILE_MUTEXES=ON) to profile the mutexes of the examples
+#if PROFILE_MUTEXES
+    typedef ProfiledMutex ExampleMutex;
+#define MUTEX_CALL_SITE mutexProfiling::callSite<__LINE__>(__FUNCTION__)
+#else
+    typedef PlainMutex ExampleMutex;
+#define MUTEX_CALL_SITE mutexProfiling::CallSite()
+#endif
+}
+
+namespace readMostlyPublication {
+    // Shared state that is read all the time and changed rarely, like a balance or a "data is loaded" status.
+    // Reading it under the writers' mutex makes every reader write to the mutex' cache line,
+    // even std::shared_mutex does that for its reader count, so readers slow each other down.
+    // Reading it with no synchronization at all can see half of an update.
+    // Both classes here give readers a consistent snapshot without writing to any shared cache line.
+
+    // SeqLock : for small trivially copyable data.
+    // The writer makes the sequence number odd, changes the data and makes it even again.
+    // A reader copies the data and retries if the sequence number was odd or has changed meanwhile.
+    // The data is kept in relaxed atomic words, so the copy of a torn value is not a data race.
+    // Writers are serialized by WriterMutex. A writer that has more to protect than the published value
+    // locks writerMutex() itself and publishes with storeLocked(), so it doesn't need a second lock.
+    template <typename T, typename WriterMutex = std::mutex>
+    class SeqLock
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable type");
+        enum { WordCount = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t) };
+
+        alignas(64) std::atomic<unsigned> m_sequence;
+        std::atomic<std::uint64_t> m_words[WordCount];
+        WriterMutex m_writerMutex;
+
+        void write(const T & value)
+        {
+            std::uint64_t words[WordCount] = {};
+            std::memcpy(words, &value, sizeof(T));
+            unsigned sequence = m_sequence.load(std::memory_order_relaxed);
+            m_sequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for (int i = 0; i < WordCount; ++i)
+                m_words[i].store(words[i], std::memory_order_relaxed);
+            m_sequence.store(sequence + 2, std::memory_order_release);
+        }
+
+    public:
+        // mutexArgs are passed on to the constructor of the WriterMutex
+        template <typename... MutexArgs>
+        explicit SeqLock(const T & initial = T(), MutexArgs &&... mutexArgs)
+            : m_sequence(0), m_writerMutex(std::forward<MutexArgs>(mutexArgs)...)
+        {
+            for (auto & word : m_words)
+                word.store(0, std::memory_order_relaxed);
+            write(initial);
+        }
+
+        T load() const
+        {
+            std::uint64_t words[WordCount];
+            unsigned before, after;
+            do
+            {
+                before = m_sequence.load(std::memory_order_acquire);
+                for (int i = 0; i < WordCount; ++i)
+                    words[i] = m_words[i].load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                after = m_sequence.load(std::memory_order_relaxed);
+            } while ((before & 1) || before != after);
+
+            T value;
+            std::memcpy(&value, words, sizeof(T));
+            return value;
+        }
+
+        void store(const T & value)
+        {
+            std::lock_guard<WriterMutex> guard(m_writerMutex);
+            write(value);
+        }
+
+        WriterMutex & writerMutex()
+        {
+            return m_writerMutex;
+        }
+
+        // The caller holds writerMutex()
+        void storeLocked(const T & value)
+        {
+            write(value);
+        }
+
+        // Read, modify and publish as one step with respect to other writers
+        template <typename Fn>
+        void update(Fn fn)
+        {
+            std::lock_guard<WriterMutex> guard(m_writerMutex);
+            T value = load();
+            fn(value);
+            write(value);
+        }
+    };
+
+    // RcuCell : for bigger objects, like a string or a container.
+    // Readers get a pointer to an immutable version of the object. A writer makes a new version,
+    // swaps the pointer and deletes the old version once no reader can still be looking at it.
+    // Readers only count themselves in and out on their own cache line, in the half of the
+    // counters the current epoch points to. The writer flips the epoch twice and waits for
+    // the readers of the other half to leave each time, like userspace RCU does.
+    template <typename T>
+    class RcuCell
+    {
+        enum { ReaderSlots = 64 };
+
+        struct alignas(64) ReaderSlot {
+            std::atomic<long> readers[2];
+            ReaderSlot() { readers[0].store(0); readers[1].store(0); }
+        };
+
+        std::atomic<const T *> m_current;
+        alignas(64) std::atomic<unsigned> m_epoch;
+        ReaderSlot m_slots[ReaderSlots];
+        std::mutex m_writerMutex;
+
+        static unsigned slotOfThisThread()
+        {
+            static std::atomic<unsigned> nextSlot(0);
+            thread_local unsigned slot = nextSlot.fetch_add(1, std::memory_order_relaxed) % ReaderSlots;
+            return slot;
+        }
+
+        void waitForReaders(unsigned half)
+        {
+            for (auto & slot : m_slots)
+                while (slot.readers[half].load(std::memory_order_seq_cst) != 0)
+                    std::this_thread::yield();
+        }
+
+    public:
+        // Keeps the version it was made with alive, don't keep it longer than needed
+        class ReadGuard
+        {
+            std::atomic<long> * m_counter;
+            const T * m_value;
+        public:
+            ReadGuard(std::atomic<long> * counter, const T * value) : m_counter(counter), m_value(value) {}
+            ReadGuard(ReadGuard && other) noexcept : m_counter(other.m_counter), m_value(other.m_value)
+            {
+                other.m_counter = nullptr;
+            }
+            ReadGuard(const ReadGuard &) = delete;
+            ReadGuard & operator=(const ReadGuard &) = delete;
+            ~ReadGuard()
+            {
+                if (m_counter)
+                    m_counter->fetch_sub(1, std::memory_order_release);
+            }
+            const T & operator*() const { return *m_value; }
+            const T * operator->() const { return m_value; }
+        };
+
+        explicit RcuCell(std::unique_ptr<T> initial = std::unique_ptr<T>(new T())) : m_current(initial.release()), m_epoch(0) {}
+
+        RcuCell(const RcuCell &) = delete;
+        RcuCell & operator=(const RcuCell &) = delete;
+
+        ~RcuCell()
+        {
+            delete m_current.load();
+        }
+
+        ReadGuard read() const
+        {
+            ReaderSlot & slot = const_cast<ReaderSlot &>(m_slots[slotOfThisThread()]);
+            std::atomic<long> * counter = &slot.readers[m_epoch.load(std::memory_order_relaxed) & 1];
+            counter->fetch_add(1, std::memory_order_seq_cst);
+            return ReadGuard(counter, m_current.load(std::memory_order_seq_cst));
+        }
+
+        void publish(std::unique_ptr<T> value)
+        {
+            std::lock_guard<std::mutex> guard(m_writerMutex);
+            const T * old = m_current.exchange(value.release(), std::memory_order_seq_cst);
+            for (int flip = 0; flip < 2; ++flip)
+            {
+                unsigned epoch = m_epoch.fetch_add(1, std::memory_order_seq_cst);
+                waitForReaders(epoch & 1);
+            }
+            delete old;
+        }
+
+        // Publishes a modified copy of the current version
+        template <typename Fn>
+        void update(Fn fn)
+        {
+            std::unique_ptr<T> value;
+            {
+                ReadGuard current = read();
+                value.reset(new T(*current));
+            }
+            fn(*value);
+            publish(std::move(value));
+        }
+    };
+
+    // A multi field state, readers must never see a balance from one update with the count of another
+    struct Balance {
+        long long money;
+        long long deposits;
+        long long lastDeposit;
+        long long check;        // money + deposits + lastDeposit, to catch torn reads
+    };
+
+    void deposit(Balance & balance, long long money)
+    {
+        balance.money += money;
+        balance.deposits += 1;
+        balance.lastDeposit = money;
+        balance.check = balance.money + balance.deposits + balance.lastDeposit;
+    }
+
+    bool isConsistent(const Balance & balance)
+    {
+        return balance.check == balance.money + balance.deposits + balance.lastDeposit;
+    }
+
+    struct MutexBalance {
+        mutable std::mutex mutex;
+        Balance balance{};
+        Balance load() const { std::lock_guard<std::mutex> guard(mutex); return balance; }
+        void deposit(long long money) { std::lock_guard<std::mutex> guard(mutex); readMostlyPublication::deposit(balance, money); }
+    };
+
+    struct SharedMutexBalance {
+        mutable std::shared_mutex mutex;
+        Balance balance{};
+        Balance load() const { std::shared_lock<std::shared_mutex> guard(mutex); return balance; }
+        void deposit(long long money) { std::unique_lock<std::shared_mutex> guard(mutex); readMostlyPublication::deposit(balance, money); }
+    };
+
+    struct SeqLockBalance {
+        SeqLock<Balance> balance{ Balance{} };
+        Balance load() const { return balance.load(); }
+        void deposit(long long money) { balance.update([money](Balance & value) { readMostlyPublication::deposit(value, money); }); }
+    };
+
+    struct RcuBalance {
+        RcuCell<Balance> balance{ std::unique_ptr<Balance>(new Balance{}) };
+        Balance load() const { return *balance.read(); }
+        void deposit(long long money) { balance.update([money](Balance & value) { readMostlyPublication::deposit(value, money); }); }
+    };
+
+    // 1 writer deposits every 'writePeriod', readerCount readers read as fast as they can.
+    // Returns the reads per second of all readers together.
+    template <typename State>
+    double readRate(int readerCount, std::chrono::microseconds writePeriod, long long & tornReads)
+    {
+        State state;
+        std::atomic<bool> done(false);
+        std::atomic<long long> reads(0);
+        std::atomic<long long> torn(0);
+
+        std::vector<std::thread> readers;
+        for (int i = 0; i < readerCount; ++i)
+        {
+            readers.emplace_back([&]() {
+                long long myReads = 0, myTorn = 0;
+                while (!done.load(std::memory_order_relaxed))
+                {
+                    if (!isConsistent(state.load()))
+                        ++myTorn;
+                    ++myReads;
+                }
+                reads += myReads;
+                torn += myTorn;
+            });
+        }
+        std::thread writer([&]() {
+            auto next = std::chrono::steady_clock::now();
+            while (!done.load(std::memory_order_relaxed))
+            {
+                state.deposit(1);
+                next += writePeriod;
+                std::this_thread::sleep_until(next);
+            }
+        });
+
+        auto duration = std::chrono::milliseconds(300);
+        std::this_thread::sleep_for(duration);
+        done = true;
+        writer.join();
+        for (auto & reader : readers)
+            reader.join();
+
+        tornReads = torn.load();
+        return reads.load() / std::chrono::duration<double>(duration).count();
+    }
+
+    void benchmarkReaders()
+    {
+        const auto writePeriod = std::chrono::microseconds(100);
+        std::cout << "1 writer every " << writePeriod.count() << " us, reads/s of all readers, ! = torn reads seen" << std::endl;
+        std::cout << "readers      std::mutex  std::shared_mutex        SeqLock        RcuCell" << std::endl;
+        for (int readerCount : { 1, 2, 4, 8 })
+        {
+            long long torn[4];
+            double rates[4] = {
+                readRate<MutexBalance>(readerCount, writePeriod, torn[0]),
+                readRate<SharedMutexBalance>(readerCount, writePeriod, torn[1]),
+                readRate<SeqLockBalance>(readerCount, writePeriod, torn[2]),
+                readRate<RcuBalance>(readerCount, writePeriod, torn[3])
+            };
+            std::cout << std::setw(7) << readerCount;
+            for (int i = 0; i < 4; ++i)
+                std::cout << std::setw(13) << static_cast<long long>(rates[i] / 1e3) << "k" << (torn[i] ? "!" : " ");
+            std::cout << std::endl;
+        }
+    }
+}
+
+namespace dataSharingAndRaceConditions {
+    // What is a Race Condition?
+    // When two or more threads perform a set of operations in parallel, 
+    // that access the same memory location.Also, one or more thread out of them modifies the data in that memory location, 
+    // then this can lead to an unexpected results some times.
+    // This is called race condition.
+
+    class Wallet {
+        int mMoney;
+    public:
+        Wallet() :mMoney(0) {}
+        int getMoney() { return mMoney; }
+        void addMoney(int money)
+        {
+            std::cout << __FUNCTION__ << "\n";
+            for (int i = 0; i < money; ++i)
+            {
+                mMoney++;
+            }
+        }
+    };
+
+    int testMultithreadedWallet()
+    {
+        Wallet walletObj;
+        std::vector<std::future<void>> tasks;
+
+        // Pool workers run addMoney() in parallel just like separate threads, so the race is still there
+        for (int i =0; i < 10; ++i)
+        {
+            tasks.push_back(workStealingThreadPool::defaultPool().submit(&Wallet::addMoney, &walletObj, 1000));
+        }
+
+        for (size_t i = 0; i < tasks.size(); ++i)
+        {
+            tasks.at(i).get();
+        }
+        return walletObj.getMoney();
+    }
+
+    void practicalExampleOfRaceCondition()
+    {
+        std::cout << "+++++++ " << __FUNCTION__ << " +++++++\n";
+        int val = testMultithreadedWallet();
+        for (int k = 0; k < 100000; k++)
+        {
+            if (val != 10000)
+            {
+                std::cout << "Error at count = " << k << " Money in Wallet = " << val << std::endl;
+            }
+        }
+        return;
+    }
+}
+
+namespace usingMutexToFixRaceConditions {
+    //  To fix race conditions in multi - threaded environment we need mutex 
+    //  i.e.each thread needs to lock a mutex before modifying or reading the shared data and 
+    //  after modifying the data each thread should unlock the mutex.
+    class Wallet
+    {
+        int mMoney;
+        // getMoney() reads the last published value, it doesn't take the lock
+        // and never reads mMoney while another thread is changing it.
+        // The writer mutex of the SeqLock is the one mutex of the wallet, addMoney() locks it.
+        readMostlyPublication::SeqLock<int, mutexProfiling::ExampleMutex> mPublishedMoney{ 0, "usingMutexToFixRaceConditions::Wallet::mutex" };
+    public:
+        Wallet() :mMoney(0) {}
+        int getMoney() { return mPublishedMoney.load(); }
+        void addMoney(int money)
+        {
+            mutexProfiling::ExampleMutex & mutex = mPublishedMoney.writerMutex();
+            mutex.lock(MUTEX_CALL_SITE);
+            for (int i = 0; i < money; ++i)
+            {
+                mMoney++;
+            }
+            mPublishedMoney.storeLocked(mMoney);
+            mutex.unlock();
+        }
+    };
+
+    int testMultithreadedWallet()
+    {
+        Wallet walletObject;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 5; ++i) {
+            threads.push_back(std::thread(&Wallet::addMoney, &walletObject, 1000));
+        }
+
+        for (int i = 0; i < threads.size(); i++)
+        {
+            threads.at(i).join();
+        }
+        return walletObject.getMoney();
+    }
+
+    void test()
+    {
+        int val = 0;
+        for (int k = 0; k < 1000; k++)
+        {
+            if ((val = testMultithreadedWallet()) != 5000)
+            {
+                std::cout << "Error at count = " << k << "  Money in Wallet = " << val << std::endl;
+                //break;
+            }
+        }
+        return;
+    }
+
+    // std::lock_guard :
+    // std::lock_guard is a class template, which implements the RAII for mutex.
+    //    It wraps the mutex inside its object and locks the attached mutex in its constructor.
+    // When its destructor is called it releases the mutex.
+
+    class Wallet2
+    {
+        int mMoney;
+        readMostlyPublication::SeqLock<int, mutexProfiling::ExampleMutex> mPublishedMoney{ 0, "usingMutexToFixRaceConditions::Wallet2::mutex" };
+    public:
+        Wallet2() :mMoney(0) {}
+        int getMoney() { return mPublishedMoney.load(); }
+        void addMoney(int money)
+        {
+            // Same as std::lock_guard<std::mutex>, it also tells the profiler where the lock is taken.
+            // The writer mutex of the SeqLock is the one mutex of the wallet.
+            mutexProfiling::LockGuard<mutexProfiling::ExampleMutex> lockGuard(mPublishedMoney.writerMutex(), MUTEX_CALL_SITE);
+            // In constructor it locks the mutex
+
+            for (int i = 0; i < money; ++i)
+            {
+                // If some exception occurs at this
+                // poin then destructor of lockGuard
+                // will be called due to stack unwinding.
+                //
+                mMoney++;
+            }
+            mPublishedMoney.storeLocked(mMoney);
+            // Once function exits, then destructor
+            // of lockGuard Object will be called.
+            // In destructor it unlocks the mutex.
+        }
+    };
+}
+
+namespace shardedCounterWallet {
+    // The mutex fixes the race condition, but now only one thread at a time can add money.
+    // Even a single std::atomic<int> doesn't scale, because every core has to take
+    // exclusive ownership of the same cache line for every increment.
+
+    // A sharded counter gives every thread its own slot to increment.
+    // Each slot lives on its own cache line, so threads never write to the same line.
+    // Reading the value means adding up all the slots.
+    // usingMutexToFixRaceConditions::Wallet / Wallet2 keep their mutex : they are the example of fixing the race
+    // with a lock, and benchmarkScaling() needs them as the mutex baseline the sharded Wallet here is measured against.
+    class ShardedCounter
+    {
+        struct alignas(64) Slot {
+            std::atomic<long long> value;
+            Slot() : value(0) {}
+        };
+
+        std::unique_ptr<Slot[]> m_slots;
+        unsigned m_slotCount;
+
+        // Every thread picks a slot the first time it touches any counter
+        static unsigned threadSlot()
+        {
+            static std::atomic<unsigned> nextSlot(0);
+            thread_local unsigned slot = nextSlot.fetch_add(1, std::memory_order_relaxed);
+            return slot;
+        }
+
+    public:
+        explicit ShardedCounter(unsigned slotCount = std::thread::hardware_concurrency())
+            : m_slots(new Slot[slotCount ? slotCount : 1]), m_slotCount(slotCount ? slotCount : 1)
+        {}
+
+        void add(long long value)
+        {
+            // Nobody else is ordered against this increment, relaxed is enough
+            m_slots[threadSlot() % m_slotCount].value.fetch_add(value, std::memory_order_relaxed);
+        }
+
+        long long get() const
+        {
+            long long sum = 0;
+            for (unsigned i = 0; i < m_slotCount; ++i)
+                sum += m_slots[i].value.load(std::memory_order_relaxed);
+            return sum;
+        }
+    };
+
+    class Wallet
+    {
+        ShardedCounter mMoney;
+    public:
+        int getMoney() { return static_cast<int>(mMoney.get()); }
+        void addMoney(int money)
+        {
+            for (int i = 0; i < money; ++i)
+            {
+                mMoney.add(1);
+            }
+        }
+    };
+
+    // Wallet with a single atomic counter, for comparison
+    class AtomicWallet
+    {
+        std::atomic<int> mMoney;
+    public:
+        AtomicWallet() :mMoney(0) {}
+        int getMoney() { return mMoney.load(); }
+        void addMoney(int money)
+        {
+            for (int i = 0; i < money; ++i)
+            {
+                mMoney.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    int testMultithreadedWallet()
+    {
+        Wallet walletObject;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 5; ++i) {
+            threads.push_back(std::thread(&Wallet::addMoney, &walletObject, 1000));
+        }
+
+        for (size_t i = 0; i < threads.size(); i++)
+        {
+            threads.at(i).join();
+        }
+        return walletObject.getMoney();
+    }
+
+    void test()
+    {
+        int val = 0;
+        for (int k = 0; k < 1000; k++)
+        {
+            if ((val = testMultithreadedWallet()) != 5000)
+            {
+                std::cout << "Error at count = " << k << "  Money in Wallet = " << val << std::endl;
+            }
+        }
+        return;
+    }
+
+    // Every thread calls addMoney(1) many times, so the wallets are hit on every single increment
+    template <typename WalletType>
+    long long timeWallet(int threadCount, int addsPerThread)
+    {
+        WalletType walletObject;
+        std::vector<std::thread> threads;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < threadCount; ++i)
+        {
+            threads.push_back(std::thread([&walletObject, addsPerThread]() {
+                for (int k = 0; k < addsPerThread; ++k)
+                    walletObject.addMoney(1);
+            }));
+        }
+        std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
+        auto elapsed = std::chrono::steady_clock::now() - start;
+
+        if (walletObject.getMoney() != threadCount * addsPerThread)
+            std::cout << "Error Money in Wallet = " << walletObject.getMoney() << std::endl;
+        return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    }
+
+    void benchmarkScaling()
+    {
+        std::cout << "+++++++" << __FUNCTION__ << "+++++++\n";
+        const int addsPerThread = 1000000;
+        int maxThreads = std::max(8, static_cast<int>(std::thread::hardware_concurrency()));
+
+        for (int threadCount = 1; threadCount <= maxThreads; threadCount *= 2)
+        {
+            std::cout << "Threads = " << threadCount
+                << "  mutex = " << timeWallet<usingMutexToFixRaceConditions::Wallet2>(threadCount, addsPerThread) << " us"
+                << "  atomic = " << timeWallet<AtomicWallet>(threadCount, addsPerThread) << " us"
+                << "  sharded = " << timeWallet<Wallet>(threadCount, addsPerThread) << " us\n";
+        }
+    }
+}
+
+
+namespace threadPlacement {
+    // Adds to one shared wallet from threads placed by 'policy'.
+    // The wallet's cache line moves between the CPUs on every increment,
+    // so it gets much slower when that line has to travel between sockets.
+    template <typename WalletType>
+    long long timeWalletWithPlacement(const AffinityPolicy & policy, int threadCount, int addsPerThread)
+    {
+        WalletType walletObject;
+        std::vector<std::thread> threads;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < threadCount; ++i)
+        {
+            threads.push_back(launchThread(policy, i, [&walletObject, addsPerThread]() {
+                for (int k = 0; k < addsPerThread; ++k)
+                    walletObject.addMoney(1);
+            }));
+        }
+        std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
+        auto elapsed = std::chrono::steady_clock::now() - start;
+
+        if (walletObject.getMoney() != threadCount * addsPerThread)
+            std::cout << "Error Money in Wallet = " << walletObject.getMoney() << std::endl;
+        return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    }
+
+    void benchmarkWalletPlacement()
+    {
+        std::cout << "+++++++" << __FUNCTION__ << "+++++++\n";
+        const Topology & topology = Topology::instance();
+        topology.print(std::cout);
+
+        const int addsPerThread = 1000000;
+        int cpuCount = static_cast<int>(topology.cpus().size());
+        // The explicit set puts every thread on the same CPU, i.e. no parallelism but no cache line traffic either
+        const AffinityPolicy policies[] = { AffinityPolicy::none(), AffinityPolicy::compact(), AffinityPolicy::scatter(),
+            AffinityPolicy::explicitCpus(std::vector<int>(1, topology.cpus().front().id)) };
+
+        // Half the machine, so compact and scatter really pick different CPUs
+        for (int threadCount : { std::max(1, cpuCount / 2), cpuCount })
+        {
+            for (const AffinityPolicy & policy : policies)
+            {
+                std::cout << "Threads = " << threadCount << "  placement = " << policy.name()
+                    << "  CPUs = ";
+                for (int i = 0; i < threadCount; ++i)
+                    std::cout << (i ? "," : "") << (policy.cpuFor(i) < 0 ? std::string("os") : std::to_string(policy.cpuFor(i)));
+                std::cout << "\n    mutex wallet = " << timeWalletWithPlacement<usingMutexToFixRaceConditions::Wallet2>(policy, threadCount, addsPerThread) << " us"
+                    << "  atomic wallet = " << timeWalletWithPlacement<shardedCounterWallet::AtomicWallet>(policy, threadCount, addsPerThread) << " us"
+                    << "  sharded wallet = " << timeWalletWithPlacement<shardedCounterWallet::Wallet>(policy, threadCount, addsPerThread) << " us\n";
+            }
+        }
+    }
+}
+
+namespace spinThenParkEvent {
+    // An Event is a flag that one thread can wait on and another thread can set.
+    // With a mutex + condition variable every set() and every wait() has to take the mutex.
+    // This Event keeps its whole state in one atomic int,
+    //    1.) set() is a single atomic exchange, and it only makes a system call if somebody is sleeping.
+    //    2.) wait() first spins for a short while, because the event is often set very soon.
+    //        The spin length adapts: it grows when spinning paid off and shrinks when it didn't.
+    //    3.) If the event is still not set, the thread sleeps in the kernel on the atomic itself (futex on Linux).
+    enum class EventMode {
+        ManualReset,    // stays set until reset(), releases all waiters (one-shot if never reset)
+        AutoReset       // every set() releases one waiter, which resets the event again
+    };
+
+    class Event {
+        enum { NotSet = 0, Set = 1, NotSetWithWaiters = 2 };
+        enum { MinSpin = 16, MaxSpin = 4096 };
+
+        std::atomic<int> m_state;
+        std::atomic<int> m_spinLimit;
+        const EventMode m_mode;
+#ifndef __linux__
+        std::mutex m_mutex;
+        std::condition_variable m_condVar;
+#endif
+
+        static void cpuRelax()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#else
+            std::this_thread::yield();
+#endif
+        }
+
+        // Sleep while the state is still 'expected'
+        void park(int expected)
+        {
+#ifdef __linux__
+            syscall(SYS_futex, reinterpret_cast<int *>(&m_state), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#else
+            std::unique_lock<std::mutex> mlock(m_mutex);
+            m_condVar.wait(mlock, [this, expected] { return m_state.load() != expected; });
+#endif
+        }
+
+        void unpark(bool all)
+        {
+#ifdef __linux__
+            syscall(SYS_futex, reinterpret_cast<int *>(&m_state), FUTEX_WAKE_PRIVATE, all ? INT_MAX : 1, nullptr, nullptr, 0);
+#else
+            std::lock_guard<std::mutex> guard(m_mutex);
+            if (all)
+                m_condVar.notify_all();
+            else
+                m_condVar.notify_one();
+#endif
+        }
+
+        // A manual reset event just has to be set, an auto reset event must also be consumed.
+        // After we have slept we leave the 'waiters' mark behind, others may still be sleeping.
+        bool tryConsume(bool hasSlept)
+        {
+            if (m_mode == EventMode::ManualReset)
+                return m_state.load(std::memory_order_acquire) == Set;
+            int expected = Set;
+            return m_state.compare_exchange_strong(expected, hasSlept ? NotSetWithWaiters : NotSet, std::memory_order_acquire);
+        }
+
+    public:
+        explicit Event(EventMode mode = EventMode::ManualReset)
+            : m_state(NotSet), m_spinLimit(MinSpin), m_mode(mode)
+        {}
+
+        Event(const Event &) = delete;
+        Event & operator=(const Event &) = delete;
+
+        void set()
+        {
+            if (m_state.exchange(Set, std::memory_order_release) == NotSetWithWaiters)
+                unpark(m_mode == EventMode::ManualReset);
+        }
+
+        void reset()
+        {
+            int expected = Set;
+            m_state.compare_exchange_strong(expected, NotSet);
+        }
+
+        bool isSet() const
+        {
+            return m_state.load(std::memory_order_acquire) == Set;
+        }
+
+        void wait()
+        {
+            // Spinning on a single core only steals time from the thread that would set the event
+            static const bool canSpin = std::thread::hardware_concurrency() > 1;
+            if (canSpin)
+            {
+                int spinLimit = m_spinLimit.load(std::memory_order_relaxed);
+                for (int i = 0; i < spinLimit; ++i)
+                {
+                    if (tryConsume(false))
+                    {
+                        m_spinLimit.store(std::min<int>(spinLimit * 2, MaxSpin), std::memory_order_relaxed);
+                        return;
+                    }
+                    cpuRelax();
+                }
+                m_spinLimit.store(std::max<int>(spinLimit / 2, MinSpin), std::memory_order_relaxed);
+            }
+
+            bool hasSlept = false;
+            while (true)
+            {
+                if (tryConsume(hasSlept))
+                    return;
+                int state = m_state.load();
+                if (state == Set)
+                    continue;
+                // Mark that somebody is going to sleep, so set() knows it has to wake us
+                if (state == NotSet && !m_state.compare_exchange_strong(state, NotSetWithWaiters))
+                    continue;
+                park(NotSetWithWaiters);
+                hasSlept = true;
+            }
+        }
+    };
+
+    // The same one-shot / auto reset behaviour built the usual way, used as the baseline
+    class CondVarEvent {
+        std::mutex m_mutex;
+        std::condition_variable m_condVar;
+        bool m_bSet;
+        const EventMode m_mode;
+    public:
+        explicit CondVarEvent(EventMode mode = EventMode::ManualReset) : m_bSet(false), m_mode(mode) {}
+        void set()
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_bSet = true;
+            if (m_mode == EventMode::ManualReset)
+                m_condVar.notify_all();
+            else
+                m_condVar.notify_one();
+        }
+        void wait()
+        {
+            std::unique_lock<std::mutex> mlock(m_mutex);
+            m_condVar.wait(mlock, [this] { return m_bSet; });
+            if (m_mode == EventMode::AutoReset)
+                m_bSet = false;
+        }
+    };
+
+    // The waiter measures the time from just before set() until it is running again.
+    // The signaller waits a little before every set(), so the waiter has time to go to sleep.
+    template <typename EventType>
+    void measureWakeLatency(const char * name, int rounds)
+    {
+        EventType wakeEvent(EventMode::AutoReset);
+        EventType ackEvent(EventMode::AutoReset);
+        std::atomic<long long> setTime(0);
+        std::vector<long long> latencies;
+        latencies.reserve(rounds);
+
+        std::thread waiter([&]() {
+            for (int i = 0; i < rounds; ++i)
+            {
+                wakeEvent.wait();
+                long long now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+                latencies.push_back(now - setTime.load());
+                ackEvent.set();
+            }
+        });
+
+        for (int i = 0; i < rounds; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            setTime.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+            wakeEvent.set();
+            ackEvent.wait();
+        }
+        waiter.join();
+
+        std::sort(latencies.begin(), latencies.end());
+        std::cout << name
+            << "  p50 = " << latencies[latencies.size() / 2] / 1000.0 << " us"
+            << "  p99 = " << latencies[latencies.size() * 99 / 100] / 1000.0 << " us"
+            << "  max = " << latencies.back() / 1000.0 << " us\n";
+
+        // Histogram with power of two buckets in microseconds
+        const long long bucketLimits[] = { 1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024 };
+        size_t from = 0;
+        for (long long limit : bucketLimits)
+        {
+            size_t to = std::lower_bound(latencies.begin(), latencies.end(), limit * 1000) - latencies.begin();
+            std::cout << "    < " << limit << " us : " << (to - from) << "\n";
+            from = to;
+        }
+        std::cout << "    >= 1024 us : " << (latencies.size() - from) << "\n";
+    }
+
+    void benchmarkWakeLatency()
+    {
+        std::cout << "+++++++" << __FUNCTION__ << "+++++++\n";
+        measureWakeLatency<CondVarEvent>("condition_variable", 10000);
+        measureWakeLatency<Event>("spin-then-park Event", 10000);
+    }
+}
+
+namespace eventHandling {
+    // option 1 
+    // Make a Boolean global variable with default value false.
+    // Set its value to true in Thread 2 and Thread 1 will keep on checking its value 
+    // in loop and as soon as it becomes true Thread 1 will continue with processing of data.
+    // Checking the flag every 100 ms means Thread 1 notices it up to 100 ms late,
+    // so instead of polling Thread 1 now waits on a spinThenParkEvent::Event.
+    class Application {
+        mutexProfiling::ExampleMutex m_mutex{ "eventHandling::Application::m_mutex" };
+        bool m_bDataloaded;
+        spinThenParkEvent::Event m_dataLoadedEvent;
+    public:
+        Application() {
+            m_bDataloaded = false;
+        }
+        void loadData()
+        {
+            //Make this thread sleep for 1 Second
+            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+            asyncLogging::log() << "Loading Data from XML";
+
+            {
+                // Lock the data structure
+                mutexProfiling::LockGuard<mutexProfiling::ExampleMutex> guard(m_mutex, MUTEX_CALL_SITE);
+
+                //Set the flag to true, means data is loaded
+                m_bDataloaded = true;
+            }
+            //Wake up the thread waiting for the data
+            m_dataLoadedEvent.set();
+        }
+
+        void mainTask()
+        {
+            asyncLogging::log() << "Do something handshaking";
+
+            //Block until the data is loaded, no lock / unlock / sleep loop
+            m_dataLoadedEvent.wait();
+
+            // The event only wakes us up, the state of the data is still read under the lock once
+            bool dataLoaded;
+            {
+                mutexProfiling::LockGuard<mutexProfiling::ExampleMutex> guard(m_mutex, MUTEX_CALL_SITE);
+                dataLoaded = m_bDataloaded;
+            }
+            if (!dataLoaded)
+            {
+                asyncLogging::log() << "Error : woken up before the data was loaded";
+                return;
+            }
+
+            //Do processing on loaded data
+            asyncLogging::log() << "Do processing  on loaded data";
+
+        }
+    };
+
+    void options1Test()
+    {
+        Application app;
+        
+        std::thread thread_1(&Application::mainTask, &app);
+        std::thread thread_2(&Application::loadData, &app);
+
+        thread_2.join();
+        thread_1.join();
+
+        // The polling loop had following disadvantages,
+        // Thread will keep on acquiring the lock and release it just to check the value, 
+        // therefore it will consume CPU cycles and will also make Thread 1 slow, because it needs to acquire same lock to update the bool flag.
+    }
+
+    // Option 2:
+
+    // We can achieve this using Condition Variables.
+    // Condition Variables
+
+    // Condition Variable is a kind of Event used for signaling between two or more threads.
+    // One or more thread can wait on it to get signaled, while an another thread can signal this.
+
+    // A condition variable needs a mutex for every signal and every wait.
+    // spinThenParkEvent::Event gives the same signaling with one atomic operation,
+    // see spinThenParkEvent::CondVarEvent for the condition variable version.
+    class Application2 {
+        spinThenParkEvent::Event m_dataLoadedEvent;
+    public:
+        void loadData()
+        {
+            //Make this thread sleep for 1 Second
+            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+            asyncLogging::log() << "Loading Data from XML";
+
+            //Signal the event, means data is loaded
+            m_dataLoadedEvent.set();
+        }
+        
+        bool isDataLoaded()
+        {
+            return m_dataLoadedEvent.isSet();
+        }
+
+        void mainTask()
+        {
+            asyncLogging::log() << "Do Some Handshaking";
+            // Start waiting for the Event to get signaled
+            // wait() spins for a short while and then blocks the thread.
+            // As soon as the event gets signaled, resume the thread.
+            m_dataLoadedEvent.wait();
+            asyncLogging::log() << "Do Processing On loaded Data";
+
+        }
+    };
+
+    void options2Test()
+    {
+        Application2 app;
+
+        std::thread thread_1(&Application2::mainTask, &app);
+        std::thread thread_2(&Application2::loadData, &app);
+
+        thread_2.join();
+        thread_1.join();
+    }
+}
+
+namespace boundedMpmcQueue {
+    // loadData() / mainTask() hand over a single flag. Real producers and consumers hand over a stream of items,
+    // usually through a queue protected by a mutex and two condition variables, which serializes every push and pop.
+
+    // MpmcQueue<> is a bounded multi-producer / multi-consumer ring buffer (Dmitry Vyukov's design).
+    //    1.) Every slot has a sequence number that says whether it is free for the producer of lap N
+    //        or filled for the consumer of lap N, so a slot is claimed with one compare-exchange on a position counter.
+    //    2.) The producer position and the consumer position live on separate cache lines,
+    //        so producers and consumers don't invalidate each other's counters.
+    //    3.) try_push() / try_pop() never block. push() / pop() only fall back to a mutex and
+    //        condition variable when the queue is full / empty and the thread really has to sleep.
+    template <typename T>
+    class MpmcQueue {
+        struct Cell {
+            std::atomic<size_t> sequence;
+            T data;
+        };
+
+        std::unique_ptr<Cell[]> m_buffer;
+        const size_t m_mask;
+        alignas(64) std::atomic<size_t> m_enqueuePos;
+        alignas(64) std::atomic<size_t> m_dequeuePos;
+        alignas(64) std::atomic<int> m_waitingProducers;
+        std::atomic<int> m_waitingConsumers;
+        std::mutex m_sleepMutex;
+        std::condition_variable m_notFull;
+        std::condition_variable m_notEmpty;
 
-        // It has following disadvantages,
-        // Thread will keep on acquiring the lock and release it just to check the value, 
-        // therefore it will consume CPU cycles and will also make Thread 1 slow, because it needs to acquire same lock to update the bool flag.
-    }
+        static size_t roundUpToPowerOfTwo(size_t value)
+        {
+            size_t result = 2;
+            while (result < value)
+                result *= 2;
+            return result;
+        }
 
-    // Option 2:
+        // Wakes the other side if somebody may be sleeping on it.
+        // The fence pairs with the one in sleepUntil(), so either we see the waiter or the waiter sees our item.
+        void wake(std::atomic<int> & waiters, std::condition_variable & condVar)
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (waiters.load(std::memory_order_relaxed) > 0)
+            {
+                std::lock_guard<std::mutex> guard(m_sleepMutex);
+                condVar.notify_all();
+            }
+        }
 
-    // We can achieve this using Condition Variables.
-    // Condition Variables
+        template <typename TryOperation>
+        void sleepUntil(std::atomic<int> & waiters, std::condition_variable & condVar, TryOperation tryOperation)
+        {
+            // Short spin first, the other side is usually just about to make progress
+            for (int i = 0; i < 64; ++i)
+            {
+                if (tryOperation())
+                    return;
+                std::this_thread::yield();
+            }
+            std::unique_lock<std::mutex> mlock(m_sleepMutex);
+            waiters.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            condVar.wait(mlock, tryOperation);
+            waiters.fetch_sub(1, std::memory_order_relaxed);
+        }
 
-    // Condition Variable is a kind of Event used for signaling between two or more threads.
-    // One or more thread can wait on it to get signaled, while an another thread can signal this.
+        // Claims a slot and moves the value in / out, without waking anybody
+        template <typename U>
+        bool tryEnqueue(U && value)
+        {
+            Cell * cell;
+            size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+            while (true)
+            {
+                cell = &m_buffer[pos & m_mask];
+                size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+                if (diff == 0)
+                {
+                    // The slot is free for this lap, try to claim it
+                    if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                {
+                    // The slot still holds the item of the previous lap, i.e. the queue is full
+                    return false;
+                }
+                else
+                {
+                    pos = m_enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+            cell->data = std::forward<U>(value);
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
 
-    class Application2 {
+        bool tryDequeue(T & value)
+        {
+            Cell * cell;
+            size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+            while (true)
+            {
+                cell = &m_buffer[pos & m_mask];
+                size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+                if (diff == 0)
+                {
+                    if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                {
+                    // Nothing produced in this slot yet, i.e. the queue is empty
+                    return false;
+                }
+                else
+                {
+                    pos = m_dequeuePos.load(std::memory_order_relaxed);
+                }
+            }
+            value = std::move(cell->data);
+            // Free the slot for the producer of the next lap
+            cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+            return true;
+        }
+
+    public:
+        explicit MpmcQueue(size_t capacity)
+            : m_buffer(new Cell[roundUpToPowerOfTwo(capacity)]), m_mask(roundUpToPowerOfTwo(capacity) - 1),
+            m_enqueuePos(0), m_dequeuePos(0), m_waitingProducers(0), m_waitingConsumers(0)
+        {
+            for (size_t i = 0; i <= m_mask; ++i)
+                m_buffer[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        MpmcQueue(const MpmcQueue &) = delete;
+        MpmcQueue & operator=(const MpmcQueue &) = delete;
+
+        size_t capacity() const { return m_mask + 1; }
+
+        template <typename U>
+        bool try_push(U && value)
+        {
+            if (!tryEnqueue(std::forward<U>(value)))
+                return false;
+            wake(m_waitingConsumers, m_notEmpty);
+            return true;
+        }
+
+        bool try_pop(T & value)
+        {
+            if (!tryDequeue(value))
+                return false;
+            wake(m_waitingProducers, m_notFull);
+            return true;
+        }
+
+        void push(T value)
+        {
+            if (!tryEnqueue(std::move(value)))
+                sleepUntil(m_waitingProducers, m_notFull, [&]() { return tryEnqueue(std::move(value)); });
+            wake(m_waitingConsumers, m_notEmpty);
+        }
+
+        T pop()
+        {
+            T value;
+            if (!tryDequeue(value))
+                sleepUntil(m_waitingConsumers, m_notEmpty, [&]() { return tryDequeue(value); });
+            wake(m_waitingProducers, m_notFull);
+            return value;
+        }
+    };
+
+    // The usual way, used as the baseline
+    template <typename T>
+    class MutexQueue {
         std::mutex m_mutex;
-        std::condition_variable m_condVar;
-        bool m_bDataloaded;
+        std::condition_variable m_notFull;
+        std::condition_variable m_notEmpty;
+        std::vector<T> m_ring;
+        size_t m_head;
+        size_t m_count;
     public:
-        Application2() {
-            m_bDataloaded = false;
+        explicit MutexQueue(size_t capacity) : m_ring(capacity), m_head(0), m_count(0) {}
+
+        void push(T value)
+        {
+            std::unique_lock<std::mutex> mlock(m_mutex);
+            m_notFull.wait(mlock, [this] { return m_count < m_ring.size(); });
+            m_ring[(m_head + m_count) % m_ring.size()] = std::move(value);
+            ++m_count;
+            m_notEmpty.notify_one();
         }
-        void loadData()
+
+        T pop()
         {
-            //Make this thread sleep for 1 Second
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-            std::cout << "Loading Data from XML\n";
+            std::unique_lock<std::mutex> mlock(m_mutex);
+            m_notEmpty.wait(mlock, [this] { return m_count > 0; });
+            T value = std::move(m_ring[m_head]);
+            m_head = (m_head + 1) % m_ring.size();
+            --m_count;
+            m_notFull.notify_one();
+            return value;
+        }
+    };
 
-            // Lock the data structure
-            std::lock_guard<std::mutex> guard(m_mutex);
+    // Producers push 'itemCount' numbers in total, consumers pop the same amount.
+    // Returns the elapsed time, 'sum' gets the sum of all popped values.
+    template <typename QueueType>
+    double runProducersConsumers(QueueType & queue, int producers, int consumers, int itemCount, long long & sum)
+    {
+        std::atomic<long long> total(0);
+        std::vector<std::thread> threads;
+        auto start = std::chrono::steady_clock::now();
+        for (int p = 0; p < producers; ++p)
+        {
+            threads.push_back(std::thread([&queue, p, producers, itemCount]() {
+                for (int i = p; i < itemCount; i += producers)
+                    queue.push(i);
+            }));
+        }
+        for (int c = 0; c < consumers; ++c)
+        {
+            threads.push_back(std::thread([&queue, &total, c, consumers, itemCount]() {
+                long long localSum = 0;
+                for (int i = c; i < itemCount; i += consumers)
+                    localSum += queue.pop();
+                total += localSum;
+            }));
+        }
+        std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        sum = total;
+        return elapsed.count();
+    }
 
-            //Set the flag to true, means data is loaded
-            m_bDataloaded = true;
-            //Notify the condition variable
-            m_condVar.notify_one();
+    // Many producers and consumers on a tiny queue, so it is full / empty all the time,
+    // then check that every item came out exactly once.
+    void stressTest()
+    {
+        std::cout << "+++++++" << __FUNCTION__ << "+++++++\n";
+        const int itemCount = 200000;
+        const long long expected = static_cast<long long>(itemCount) * (itemCount - 1) / 2;
+        const int ratios[][2] = { { 1, 1 }, { 4, 4 }, { 8, 1 }, { 1, 8 }, { 3, 5 } };
+
+        for (auto & ratio : ratios)
+        {
+            MpmcQueue<int> queue(4);
+            long long sum = 0;
+            runProducersConsumers(queue, ratio[0], ratio[1], itemCount, sum);
+            if (sum != expected)
+                std::cout << "Error at " << ratio[0] << ":" << ratio[1] << " sum = " << sum << " expected = " << expected << std::endl;
+            int leftover;
+            if (queue.try_pop(leftover))
+                std::cout << "Error at " << ratio[0] << ":" << ratio[1] << " queue not empty" << std::endl;
         }
-        
-        bool isDataLoaded()
+
+        // try variants on a full and an empty queue
+        MpmcQueue<int> queue(2);
+        int value = 0;
+        if (queue.try_pop(value) || !queue.try_push(1) || !queue.try_push(2) || queue.try_push(3))
+            std::cout << "Error try_push / try_pop on full or empty queue" << std::endl;
+        if (!queue.try_pop(value) || value != 1 || !queue.try_pop(value) || value != 2)
+            std::cout << "Error items out of order" << std::endl;
+        std::cout << "Stress test done" << std::endl;
+    }
+
+    void benchmarkThroughput()
+    {
+        std::cout << "+++++++" << __FUNCTION__ << "+++++++\n";
+        const int itemCount = 2000000;
+        const int ratios[][2] = { { 1, 1 }, { 4, 4 }, { 8, 1 } };
+
+        for (auto & ratio : ratios)
+        {
+            long long sum = 0;
+            MutexQueue<int> mutexQueue(1024);
+            double mutexTime = runProducersConsumers(mutexQueue, ratio[0], ratio[1], itemCount, sum);
+            MpmcQueue<int> lockFreeQueue(1024);
+            double lockFreeTime = runProducersConsumers(lockFreeQueue, ratio[0], ratio[1], itemCount, sum);
+
+            std::cout << "Producers:Consumers = " << ratio[0] << ":" << ratio[1]
+                << "  mutex + condition_variable = " << itemCount / mutexTime / 1e6 << " M items/s"
+                << "  MpmcQueue = " << itemCount / lockFreeTime / 1e6 << " M items/s\n";
+        }
+    }
+}
+
+
+namespace futurePromiseAndReturningValue {
+    // Suppose in our application we created a thread that will 
+    // compress a given folder and we want this thread to 
+    // return the new zip file name and its size in result.
+
+    // 1.) Old Way : Share data among threads using pointer
+    // Pass a pointer to the new thread and this thread will set the data in it. 
+    // Till then in main thread keep on waiting using a condition variable. 
+    // When new thread sets the data and signals the condition variable, 
+    // then main thread will wake up and fetch the data from that pointer.
+
+    // 2.) C++11 Way : Using std::future and std::promise
+    // std::future is a class template and its object stores the future value.
+    // Actually a std::future object internally stores a value that will be 
+    // assigned in future and it also provides a mechanism to access that value i.e. 
+    // using get() member function. But if somebody tries to access this associated value of 
+    // future through get() function before it is available, then get() function will block till value is not available.
+
+    // std::promise is also a class template and its object promises to set the value in future. 
+    // Each std::promise object has an associated std::future object that will 
+    // give the value once set by the std::promise object. 
+
+    //step by step
+    // 1. Create a std::promise object in Thread1. std::promise<int> promiseObj;
+    
+    // 2. But now suppose Thread 1 created this promise object and passed it to Thread 2 object. Now how Thread 1 can know that when Thread 2 is going to set the value in this promise object?
+
+    // 3. The answer is using std::future object. Every std::promise object has an associated std::future object, through which others can fetch the value set by promise.
+
+    // 4. So, Thread 1 will create the std::promise object and then fetch the std::future object from it before passing the stdpromise object to thread 2 i.e.
+    // std::future<int> futureObj = promiseObj.get_future();
+
+    //Then Thread 1 will fetch the value set by Thread 2 in std::promise through std::futures get function,
+    //    int val = futureObj.get();
+
+    //But if value is not yet set by thread 2 then this call will get blocked until thread 2 sets the value in promise object i.e.
+    //    promiseObj.set_value(45);
+    void initiazer(std::promise<int> * promObj)
+    {
+        std::cout << "Inside Thread" << std::endl;
+        promObj->set_value(35);
+    }
+
+    void test()
+    {
+        std::promise<int> promiseObj;
+        std::future<int> futureObj = promiseObj.get_future();
+        std::thread threadObj(initiazer, &promiseObj);
+        std::cout << futureObj.get() << std::endl;
+        threadObj.join();
+        return;
+    }
+}
+
+namespace inlinePromiseFuture {
+    // std::promise<> and std::future<> share a state that is allocated on the heap,
+    // and setting or getting the value locks a mutex inside that state.
+    // For one producer handing one value to one consumer we don't need any of that.
+
+    // Here the shared state is a Slot<T> that the caller places wherever it wants,
+    // i.e. on the stack, inside another object or in a preallocated array.
+    // Promise<T> and Future<T> just point to the slot, so creating a pair never allocates.
+    // The value is signaled through a spinThenParkEvent::Event i.e. one atomic exchange.
+    // The slot must outlive its Promise and Future, and can be reset() and reused after get().
+    // Slot<void> only signals completion; its storage holds an empty Unit.
+    template <typename T> class Promise;
+    template <typename T> class Future;
+
+    struct Unit {};
+
+    template <typename T>
+    class Slot {
+        typedef typename std::conditional<std::is_void<T>::value, Unit, T>::type Stored;
+
+        spinThenParkEvent::Event m_ready;
+        typename std::aligned_storage<sizeof(Stored), alignof(Stored)>::type m_storage;
+        std::exception_ptr m_exception;
+        bool m_hasValue;
+        bool m_retrieved;
+
+        Stored * value() { return reinterpret_cast<Stored *>(&m_storage); }
+
+        friend class Promise<T>;
+        friend class Future<T>;
+    public:
+        Slot() : m_hasValue(false), m_retrieved(false) {}
+        Slot(const Slot &) = delete;
+        Slot & operator=(const Slot &) = delete;
+        ~Slot() { reset(); }
+
+        // Only when neither the producer nor the consumer uses the slot any more
+        void reset()
+        {
+            if (m_hasValue)
+                value()->~Stored();
+            m_hasValue = false;
+            m_retrieved = false;
+            m_exception = nullptr;
+            m_ready.reset();
+        }
+    };
+
+    template <typename T>
+    class Promise {
+        Slot<T> * m_slot;
+        bool m_satisfied;
+    public:
+        explicit Promise(Slot<T> & slot) : m_slot(&slot), m_satisfied(false) {}
+        Promise(Promise && obj) noexcept : m_slot(obj.m_slot), m_satisfied(obj.m_satisfied)
+        {
+            obj.m_slot = nullptr;
+        }
+        Promise(const Promise &) = delete;
+        Promise & operator=(const Promise &) = delete;
+
+        // Like std::promise<>, dropping a promise without a value gives a broken_promise error
+        ~Promise()
+        {
+            if (m_slot && !m_satisfied)
+                set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+        }
+
+        Future<T> get_future() { return Future<T>(*m_slot); }
+
+        // set_value() without an argument for Promise<void>
+        template <typename... U>
+        void set_value(U &&... val)
+        {
+            if (m_satisfied)
+                throw std::future_error(std::future_errc::promise_already_satisfied);
+            new (m_slot->value()) typename Slot<T>::Stored(std::forward<U>(val)...);
+            m_slot->m_hasValue = true;
+            m_satisfied = true;
+            m_slot->m_ready.set();
+        }
+
+        void set_exception(std::exception_ptr exception)
+        {
+            if (m_satisfied)
+                throw std::future_error(std::future_errc::promise_already_satisfied);
+            m_slot->m_exception = exception;
+            m_satisfied = true;
+            m_slot->m_ready.set();
+        }
+    };
+
+    template <typename T>
+    class Future {
+        Slot<T> * m_slot;
+    public:
+        explicit Future(Slot<T> & slot) : m_slot(&slot) {}
+
+        bool is_ready() const { return m_slot->m_ready.isSet(); }
+
+        void wait() const { m_slot->m_ready.wait(); }
+
+        // Blocks till the value is set, then moves it out. Can be called only once per value.
+        T get()
+        {
+            wait();
+            if (m_slot->m_retrieved)
+                throw std::future_error(std::future_errc::future_already_retrieved);
+            m_slot->m_retrieved = true;
+            if (m_slot->m_exception)
+                std::rethrow_exception(m_slot->m_exception);
+            if constexpr (!std::is_void<T>::value)
+                return std::move(*m_slot->value());
+        }
+    };
+
+    void initiazer(Promise<int> * promObj)
+    {
+        std::cout << "Inside Thread" << std::endl;
+        promObj->set_value(35);
+    }
+
+    void test()
+    {
+        // The shared state lives on this stack frame, no heap allocation
+        Slot<int> slot;
+        Promise<int> promiseObj(slot);
+        Future<int> futureObj = promiseObj.get_future();
+        std::thread threadObj(initiazer, &promiseObj);
+        std::cout << futureObj.get() << std::endl;
+        threadObj.join();
+
+        // Exceptions are passed through the slot too
+        Slot<int> errorSlot;
+        Promise<int> errorPromise(errorSlot);
+        Future<int> errorFuture = errorPromise.get_future();
+        std::thread errorThread([&errorPromise]() {
+            errorPromise.set_exception(std::make_exception_ptr(std::runtime_error("Failed to compress")));
+        });
+        try
+        {
+            errorFuture.get();
+        }
+        catch (const std::exception & e)
+        {
+            std::cout << "Exception from thread: " << e.what() << std::endl;
+        }
+        errorThread.join();
+        return;
+    }
+
+    // Hand-off throughput: the consumer creates N promise / future pairs,
+    // the producer sets the values in order and the consumer gets them in order.
+    // Creating the pairs is part of the measurement, that is where std::promise<> allocates.
+    template <typename MakePairs, typename SetValue, typename GetValue>
+    double handOffRate(int count, MakePairs makePairs, SetValue setValue, GetValue getValue)
+    {
+        auto start = std::chrono::steady_clock::now();
+        makePairs(count);
+        std::thread producer([&]() {
+            for (int i = 0; i < count; ++i)
+                setValue(i);
+        });
+        long long sum = 0;
+        for (int i = 0; i < count; ++i)
+            sum += getValue(i);
+        producer.join();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        if (sum != static_cast<long long>(count) * (count - 1) / 2)
+            std::cout << "Error sum = " << sum << std::endl;
+        return count / elapsed.count();
+    }
+
+    // Hand-off latency: ping-pong between two threads, a fresh pair for every message.
+    // Half of the round trip time is the time of one hand-off.
+    template <typename MakePairs, typename SetValue, typename GetValue>
+    double handOffLatencyNs(int count, MakePairs makePairs, SetValue setValue, GetValue getValue)
+    {
+        // pairs 2 * i are pings, pairs 2 * i + 1 are pongs
+        makePairs(2 * count);
+        std::thread responder([&]() {
+            for (int i = 0; i < count; ++i)
+                setValue(2 * i + 1, getValue(2 * i));
+        });
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; ++i)
+        {
+            setValue(2 * i, i);
+            getValue(2 * i + 1);
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        responder.join();
+        return elapsed.count() / count / 2;
+    }
+
+    void benchmarkHandOff()
+    {
+        std::cout << "+++++++" << __FUNCTION__ << "+++++++\n";
+        const int count = 1000000;
+        const int pingPongs = 100000;
+
+        std::vector<std::promise<int>> stdPromises;
+        std::vector<std::future<int>> stdFutures;
+        auto makeStdPairs = [&](int n) {
+            stdPromises = std::vector<std::promise<int>>(n);
+            stdFutures.clear();
+            stdFutures.reserve(n);
+            for (int i = 0; i < n; ++i)
+                stdFutures.push_back(stdPromises[i].get_future());
+        };
+        auto setStd = [&](int i, int value) { stdPromises[i].set_value(value); };
+        auto getStd = [&](int i) { return stdFutures[i].get(); };
+
+        std::unique_ptr<Slot<int>[]> slots;
+        std::vector<Promise<int>> promises;
+        std::vector<Future<int>> futures;
+        auto makeSlotPairs = [&](int n) {
+            // One allocation for the whole batch instead of one per pair
+            slots.reset(new Slot<int>[n]);
+            promises.clear();
+            futures.clear();
+            promises.reserve(n);
+            futures.reserve(n);
+            for (int i = 0; i < n; ++i)
+            {
+                promises.push_back(Promise<int>(slots[i]));
+                futures.push_back(promises.back().get_future());
+            }
+        };
+        auto setSlot = [&](int i, int value) { promises[i].set_value(value); };
+        auto getSlot = [&](int i) { return futures[i].get(); };
+
+        std::cout << "std::promise / std::future  : "
+            << handOffRate(count, makeStdPairs, [&](int i) { setStd(i, i); }, getStd) << " hand-offs/s  "
+            << handOffLatencyNs(pingPongs, makeStdPairs, setStd, getStd) << " ns/hand-off\n";
+        std::cout << "Slot Promise / Future       : "
+            << handOffRate(count, makeSlotPairs, [&](int i) { setSlot(i, i); }, getSlot) << " hand-offs/s  "
+            << handOffLatencyNs(pingPongs, makeSlotPairs, setSlot, getSlot) << " ns/hand-off\n";
+    }
+}
+
+namespace continuationFutures {
+    // std::future<> only offers get(), so the only way to combine results is to block a thread in get().
+    // Waiting for N sources like that ties up a thread for every pending result.
+
+    // This Future<T> lets us attach work that runs when the value arrives,
+    //    1.) then(fn)      - run fn(value) on the thread pool once the value is ready, gives a new Future
+    //    2.) when_all(fs)  - a Future of all the values, ready when every input is ready
+    //    3.) when_any(fs)  - a Future of the first value that arrives and its index
+    // Nobody waits in between, threads are only busy while a continuation is actually running.
+    template <typename T> class Future;
+
+    template <typename T>
+    struct SharedState {
+        std::mutex mutex;
+        std::condition_variable condVar;
+        bool ready = false;
+        std::unique_ptr<T> value;
+        std::exception_ptr exception;
+        std::vector<std::function<void()>> continuations;
+
+        // Sets the value or the exception and runs the continuations, returns false if it was set already
+        bool complete(std::unique_ptr<T> newValue, std::exception_ptr newException)
+        {
+            std::vector<std::function<void()>> toRun;
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                if (ready)
+                    return false;
+                value = std::move(newValue);
+                exception = newException;
+                ready = true;
+                toRun.swap(continuations);
+            }
+            condVar.notify_all();
+            for (auto & continuation : toRun)
+                continuation();
+            return true;
+        }
+    };
+
+    // Copies of a Promise share one producer. When the last copy goes away without a value
+    // (a pool job that was dropped, or threw before set_value()), the future gets a broken_promise error,
+    // like with std::promise<>, instead of get() and every then() after it waiting forever.
+    template <typename T>
+    class Promise {
+        struct Producer {
+            std::shared_ptr<SharedState<T>> state;
+
+            explicit Producer(std::shared_ptr<SharedState<T>> sharedState) : state(std::move(sharedState)) {}
+            ~Producer()
+            {
+                state->complete(nullptr, std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+            }
+        };
+
+        std::shared_ptr<Producer> m_producer;
+
+        void complete(std::unique_ptr<T> value, std::exception_ptr exception)
+        {
+            if (!m_producer->state->complete(std::move(value), exception))
+                throw std::future_error(std::future_errc::promise_already_satisfied);
+        }
+    public:
+        Promise() : m_producer(std::make_shared<Producer>(std::make_shared<SharedState<T>>())) {}
+
+        Future<T> get_future() const { return Future<T>(m_producer->state); }
+
+        void set_value(T value)
+        {
+            complete(std::unique_ptr<T>(new T(std::move(value))), nullptr);
+        }
+
+        void set_exception(std::exception_ptr exception)
+        {
+            complete(nullptr, exception);
+        }
+    };
+
+    template <typename T>
+    class Future {
+        std::shared_ptr<SharedState<T>> m_state;
+
+        template <typename U> friend class Future;
+
+        // Calls 'callback' on the thread that sets the value, or right away if it is already set.
+        // It must be short, real work goes to the pool through then().
+        void onReady(std::function<void()> callback) const
+        {
+            {
+                std::lock_guard<std::mutex> guard(m_state->mutex);
+                if (!m_state->ready)
+                {
+                    m_state->continuations.push_back(std::move(callback));
+                    return;
+                }
+            }
+            callback();
+        }
+
+        template <typename U> friend Future<std::vector<U>> when_all(const std::vector<Future<U>> & futures);
+        template <typename U> friend Future<std::pair<size_t, U>> when_any(const std::vector<Future<U>> & futures);
+    public:
+        explicit Future(std::shared_ptr<SharedState<T>> state) : m_state(std::move(state)) {}
+
+        bool is_ready() const
+        {
+            std::lock_guard<std::mutex> guard(m_state->mutex);
+            return m_state->ready;
+        }
+
+        // Blocking get(), only for the very end of a chain
+        T get() const
         {
-            return m_bDataloaded;
+            std::unique_lock<std::mutex> mlock(m_state->mutex);
+            m_state->condVar.wait(mlock, [this] { return m_state->ready; });
+            if (m_state->exception)
+                std::rethrow_exception(m_state->exception);
+            return *m_state->value;
         }
 
-        void mainTask()
+        // fn gets the value and runs on workStealingThreadPool::defaultPool().
+        // If this future holds an exception, fn is skipped and the exception is passed on.
+        template <typename Fn>
+        auto then(Fn fn) const -> Future<decltype(fn(std::declval<T>()))>
         {
-            std::cout << "Do Some Handshaking" << std::endl;
-            // Acquire the lock
-            std::unique_lock<std::mutex> mlock(m_mutex);
-            // Start waiting for the Condition Variable to get signaled
-            // Wait() will internally release the lock and make the thread to block
-            // As soon as condition variable get signaled, resume the thread and
-            // again acquire the lock. Then check if condition is met or not
-            // If condition is met then continue else again go in wait.
-            m_condVar.wait(mlock, std::bind(&Application2::isDataLoaded, this));
-            std::cout << "Do Processing On loaded Data" << std::endl;
-
+            typedef decltype(fn(std::declval<T>())) Result;
+            Promise<Result> promise;
+            std::shared_ptr<SharedState<T>> state = m_state;
+            onReady([state, promise, fn]() {
+                workStealingThreadPool::defaultPool().submit([state, promise, fn]() mutable {
+                    if (state->exception)
+                    {
+                        promise.set_exception(state->exception);
+                        return;
+                    }
+                    try
+                    {
+                        promise.set_value(fn(*state->value));
+                    }
+                    catch (...)
+                    {
+                        promise.set_exception(std::current_exception());
+                    }
+                });
+            });
+            return promise.get_future();
         }
     };
 
-    void options2Test()
+    template <typename T>
+    Future<T> make_ready_future(T value)
     {
-        Application2 app;
-
-        std::thread thread_1(&Application2::mainTask, &app);
-        std::thread thread_2(&Application2::loadData, &app);
-
-        thread_2.join();
-        thread_1.join();
+        Promise<T> promise;
+        promise.set_value(std::move(value));
+        return promise.get_future();
     }
-}
-
-
-namespace futurePromiseAndReturningValue {
-    // Suppose in our application we created a thread that will 
-    // compress a given folder and we want this thread to 
-    // return the new zip file name and its size in result.
-
-    // 1.) Old Way : Share data among threads using pointer
-    // Pass a pointer to the new thread and this thread will set the data in it. 
-    // Till then in main thread keep on waiting using a condition variable. 
-    // When new thread sets the data and signals the condition variable, 
-    // then main thread will wake up and fetch the data from that pointer.
 
-    // 2.) C++11 Way : Using std::future and std::promise
-    // std::future is a class template and its object stores the future value.
-    // Actually a std::future object internally stores a value that will be 
-    // assigned in future and it also provides a mechanism to access that value i.e. 
-    // using get() member function. But if somebody tries to access this associated value of 
-    // future through get() function before it is available, then get() function will block till value is not available.
+    // Ready when all inputs are ready, values keep the order of the inputs.
+    // The first exception of any input becomes the exception of the result.
+    template <typename T>
+    Future<std::vector<T>> when_all(const std::vector<Future<T>> & futures)
+    {
+        struct Gather {
+            std::mutex mutex;
+            std::vector<T> values;
+            size_t remaining;
+            bool failed = false;
+            Promise<std::vector<T>> promise;
+        };
+        auto gather = std::make_shared<Gather>();
+        gather->values.resize(futures.size());
+        gather->remaining = futures.size();
+        if (futures.empty())
+            gather->promise.set_value(std::vector<T>());
 
-    // std::promise is also a class template and its object promises to set the value in future. 
-    // Each std::promise object has an associated std::future object that will 
-    // give the value once set by the std::promise object. 
+        for (size_t i = 0; i < futures.size(); ++i)
+        {
+            std::shared_ptr<SharedState<T>> state = futures[i].m_state;
+            futures[i].onReady([gather, state, i]() {
+                std::unique_lock<std::mutex> mlock(gather->mutex);
+                if (gather->failed)
+                    return;
+                if (state->exception)
+                {
+                    gather->failed = true;
+                    mlock.unlock();
+                    gather->promise.set_exception(state->exception);
+                    return;
+                }
+                gather->values[i] = *state->value;
+                if (--gather->remaining == 0)
+                {
+                    mlock.unlock();
+                    gather->promise.set_value(std::move(gather->values));
+                }
+            });
+        }
+        return gather->promise.get_future();
+    }
 
-    //step by step
-    // 1. Create a std::promise object in Thread1. std::promise<int> promiseObj;
-    
-    // 2. But now suppose Thread 1 created this promise object and passed it to Thread 2 object. Now how Thread 1 can know that when Thread 2 is going to set the value in this promise object?
+    // Ready as soon as the first input is ready, gives its index and value (or its exception)
+    template <typename T>
+    Future<std::pair<size_t, T>> when_any(const std::vector<Future<T>> & futures)
+    {
+        struct First {
+            std::atomic<bool> done{ false };
+            Promise<std::pair<size_t, T>> promise;
+        };
+        auto first = std::make_shared<First>();
+        // Nothing could ever make it ready
+        if (futures.empty())
+            first->promise.set_exception(std::make_exception_ptr(std::invalid_argument("when_any() of no futures")));
+        for (size_t i = 0; i < futures.size(); ++i)
+        {
+            std::shared_ptr<SharedState<T>> state = futures[i].m_state;
+            futures[i].onReady([first, state, i]() {
+                if (first->done.exchange(true))
+                    return;
+                if (state->exception)
+                    first->promise.set_exception(state->exception);
+                else
+                    first->promise.set_value(std::make_pair(i, *state->value));
+            });
+        }
+        return first->promise.get_future();
+    }
 
-    // 3. The answer is using std::future object. Every std::promise object has an associated std::future object, through which others can fetch the value set by promise.
+    // Simulates slow I/O without blocking a thread per request:
+    // one thread keeps the pending completions sorted by time and runs each one when it is due.
+    class IoSimulator {
+        std::mutex m_mutex;
+        std::condition_variable m_condVar;
+        std::multimap<std::chrono::steady_clock::time_point, std::function<void()>> m_pending;
+        bool m_done;
+        std::thread m_thread;
 
-    // 4. So, Thread 1 will create the std::promise object and then fetch the std::future object from it before passing the stdpromise object to thread 2 i.e.
-    // std::future<int> futureObj = promiseObj.get_future();
+        void run()
+        {
+            std::unique_lock<std::mutex> mlock(m_mutex);
+            while (!m_done || !m_pending.empty())
+            {
+                if (m_pending.empty())
+                {
+                    m_condVar.wait(mlock);
+                    continue;
+                }
+                auto due = m_pending.begin()->first;
+                if (std::chrono::steady_clock::now() < due)
+                {
+                    m_condVar.wait_until(mlock, due);
+                    continue;
+                }
+                std::function<void()> completion = std::move(m_pending.begin()->second);
+                m_pending.erase(m_pending.begin());
+                mlock.unlock();
+                completion();
+                mlock.lock();
+            }
+        }
+    public:
+        IoSimulator() : m_done(false), m_thread(&IoSimulator::run, this) {}
+        ~IoSimulator()
+        {
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                m_done = true;
+            }
+            m_condVar.notify_one();
+            m_thread.join();
+        }
 
-    //Then Thread 1 will fetch the value set by Thread 2 in std::promise through std::futures get function,
-    //    int val = futureObj.get();
+        void completeAfter(std::chrono::steady_clock::duration latency, std::function<void()> completion)
+        {
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                m_pending.insert(std::make_pair(std::chrono::steady_clock::now() + latency, std::move(completion)));
+            }
+            m_condVar.notify_one();
+        }
 
-    //But if value is not yet set by thread 2 then this call will get blocked until thread 2 sets the value in promise object i.e.
-    //    promiseObj.set_value(45);
-    void initiazer(std::promise<int> * promObj)
-    {
-        std::cout << "Inside Thread" << std::endl;
-        promObj->set_value(35);
-    }
+        static IoSimulator & instance()
+        {
+            static IoSimulator simulator;
+            return simulator;
+        }
+    };
 
-    void test()
+    // Number of threads in this process, from /proc (0 where that is not available)
+    int currentThreadCount()
     {
-        std::promise<int> promiseObj;
-        std::future<int> futureObj = promiseObj.get_future();
-        std::thread threadObj(initiazer, &promiseObj);
-        std::cout << futureObj.get() << std::endl;
-        threadObj.join();
-        return;
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            if (line.compare(0, 8, "Threads:") == 0)
+                return std::stoi(line.substr(8));
+        }
+        return 0;
     }
 }
 
@@ -519,6 +3498,15 @@ namespace asyncTutorialAndExample {
 
     // template <class Fn, class... Args>
     // future<typename result_of<Fn(Args...)>::type> async(launch policy, Fn&& fn, Args&&... args);
+
+    // With std::async() every pending result needs a thread blocked in get().
+    // The examples below fetch from N sources at once with continuationFutures instead:
+    // the fetches are started (fan-out), their results are combined with when_all() / when_any() (fan-in)
+    // and the main thread only waits for the final answer.
+    using continuationFutures::Future;
+    using continuationFutures::Promise;
+
+    const int numberOfSources = 1000;
     
     std::string fetchDataFromDB(std::string recvdData)
     {
@@ -538,32 +3526,62 @@ namespace asyncTutorialAndExample {
         return "File_" + recvdData;
     }
 
-    //Calling std::async with function pointer as callback
-    void test1()
+    // Non-blocking versions: the result arrives after 5 seconds, but no thread sleeps for it
+    Future<std::string> fetchDataFromDBAsync(std::string recvdData)
     {
-        // Get Start Time
-        system_clock::time_point start = system_clock::now();
+        Promise<std::string> promise;
+        continuationFutures::IoSimulator::instance().completeAfter(seconds(5), [promise, recvdData]() mutable {
+            promise.set_value("DB_" + recvdData);
+        });
+        return promise.get_future();
+    }
 
-        std::future<std::string> resultFromDB = std::async(std::launch::async, fetchDataFromDB, "Data");
+    Future<std::string> fetchDataFromFileAsync(std::string recvdData)
+    {
+        Promise<std::string> promise;
+        continuationFutures::IoSimulator::instance().completeAfter(seconds(5), [promise, recvdData]() mutable {
+            promise.set_value("File_" + recvdData);
+        });
+        return promise.get_future();
+    }
 
-        //Fetch Data from File
-        std::string fileData = fetchDataFromFile("Data");
+    void printMetrics(system_clock::time_point start, int peakThreads)
+    {
+        auto diff = duration_cast<std::chrono::milliseconds>(system_clock::now() - start).count();
+        // The pool threads may only have been started by the continuations
+        peakThreads = std::max(peakThreads, continuationFutures::currentThreadCount());
+        std::cout << "Total Time Taken = " << diff << " ms"
+            << "  Sources = " << numberOfSources
+            << "  Peak Threads = " << peakThreads << std::endl;
+    }
 
-        //Fetch Data from DB
-        // Will block till data is available in future<std::string> object.
-        std::string dbData = resultFromDB.get();
+    //Fan-out with function pointers as callback
+    void test1()
+    {
+        // Get Start Time
+        system_clock::time_point start = system_clock::now();
 
-        // Get End Time
-        auto end = system_clock::now();
+        // Start fetching from all sources, half of them DB and half of them File
+        Future<std::string>(*fetchers[])(std::string) = { &fetchDataFromDBAsync, &fetchDataFromFileAsync };
+        std::vector<Future<std::string>> results;
+        for (int i = 0; i < numberOfSources; ++i)
+            results.push_back(fetchers[i % 2]("Data" + std::to_string(i)));
+        int peakThreads = continuationFutures::currentThreadCount();
 
-        auto diff = duration_cast <std::chrono::seconds> (end - start).count();
-        std::cout << "Total Time Taken = " << diff << " Seconds" << std::endl;
+        //Combine The Data once everything has arrived
+        Future<std::string> combined = continuationFutures::when_all(results).then([](std::vector<std::string> parts) {
+            std::string data = parts.front();
+            for (size_t i = 1; i < parts.size(); ++i)
+                data += " :: " + parts[i];
+            return data;
+        });
 
-        //Combine The Data
-        std::string data = dbData + " :: " + fileData;
+        //Only the final result is waited for
+        std::string data = combined.get();
+        printMetrics(start, peakThreads);
 
-        //Printing the combined Data
-        std::cout << "Data = " << data << std::endl;
+        //Printing the beginning of the combined Data
+        std::cout << "Data = " << data.substr(0, 64) << " ..." << std::endl;
 
         return;
     }
@@ -573,35 +3591,283 @@ namespace asyncTutorialAndExample {
     */
     struct DataFetcher
     {
-        std::string operator()(std::string recvdData)
+        Future<std::string> operator()(std::string recvdData)
         {
-            // Make sure that function takes 5 seconds to complete
-            std::this_thread::sleep_for(seconds(5));
-            //Do stuff like fetching Data File
-            return "File_" + recvdData;
-
+            //Do stuff like fetching Data File, completes in 5 seconds
+            return fetchDataFromFileAsync(recvdData);
         }
     };
-    //Calling std::async with Function Object as callback
+    //Fan-out with Function Object as callback
     void test2()
     {
-        //Calling std::async with function object
-        std::future<std::string> fileResult = std::async(DataFetcher(), "Data");
-        std::cout << "function object: " << fileResult.get() << std::endl;
+        system_clock::time_point start = system_clock::now();
+
+        DataFetcher fetcher;
+        std::vector<Future<size_t>> sizes;
+        for (int i = 0; i < numberOfSources; ++i)
+            sizes.push_back(fetcher("Data" + std::to_string(i)).then([](std::string data) { return data.size(); }));
+        int peakThreads = continuationFutures::currentThreadCount();
+
+        std::vector<size_t> allSizes = continuationFutures::when_all(sizes).get();
+        printMetrics(start, peakThreads);
+        std::cout << "function object: " << std::accumulate(allSizes.begin(), allSizes.end(), size_t(0)) << " bytes fetched" << std::endl;
     }
 
-    //Calling std::async with Lambda function as callback
+    //Fan-out with Lambda function as callback, use the first answer
     void test3()
     {
-        //Calling std::async with lambda function
-        std::future<std::string> resultFromDB = std::async([](std::string recvdData) {
-            std::this_thread::sleep_for(seconds(5));
-            //Do stuff like creating DB Connection and fetching Data
-            return "DB_" + recvdData;
+        system_clock::time_point start = system_clock::now();
+
+        auto fetchFromReplica = [](int replica) {
+            Promise<std::string> promise;
+            // Every replica answers a little later than the previous one
+            continuationFutures::IoSimulator::instance().completeAfter(seconds(5) + milliseconds(replica), [promise, replica]() mutable {
+                //Do stuff like creating DB Connection and fetching Data
+                promise.set_value("DB_Data_from_replica_" + std::to_string(replica));
+            });
+            return promise.get_future();
+        };
+
+        std::vector<Future<std::string>> replicas;
+        for (int i = 0; i < numberOfSources; ++i)
+            replicas.push_back(fetchFromReplica(i));
+        int peakThreads = continuationFutures::currentThreadCount();
+
+        std::pair<size_t, std::string> first = continuationFutures::when_any(replicas).get();
+        printMetrics(start, peakThreads);
+        std::cout << "lambda result: " << first.second << " (source " << first.first << ")" << std::endl;
+    }
+}
+
+namespace boundedAsync {
+    // std::async(std::launch::async, ...) may start a new thread for every call.
+    // Under a burst of calls that means thousands of threads, each with its own stack.
+
+    // BoundedExecutor runs the calls on a fixed number of threads, and keeps at most 'maxQueued' calls waiting.
+    // When the queue is full the overflow policy decides,
+    //    1.) Reject     - throw std::system_error(resource_unavailable_try_again), like std::async when it can't create a thread
+    //    2.) CallerRuns - run the call right away on the calling thread, which also slows down the caller
+    // boundedAsync::async() takes the same arguments as std::async() and gives the same std::future<>.
+    class BoundedExecutor {
+    public:
+        enum class OverflowPolicy { Reject, CallerRuns };
+        typedef smallBufferTask::Task<void(), 128> Job;
+
+    private:
+        boundedMpmcQueue::MpmcQueue<Job> m_queue;
+        std::vector<std::thread> m_workers;
+        std::atomic<size_t> m_queued;
+        std::atomic<size_t> m_rejected;
+        std::atomic<size_t> m_callerRuns;
+        const size_t m_maxQueued;
+        const OverflowPolicy m_policy;
+
+        void workerLoop()
+        {
+            while (true)
+            {
+                Job job = m_queue.pop();
+                // An empty job is the signal to exit
+                if (!job)
+                    return;
+                m_queued.fetch_sub(1, std::memory_order_relaxed);
+                job();
+            }
+        }
+
+    public:
+        BoundedExecutor(unsigned concurrency, size_t maxQueued, OverflowPolicy policy)
+            : m_queue(maxQueued + std::max(1u, concurrency)), m_queued(0), m_rejected(0), m_callerRuns(0),
+            m_maxQueued(maxQueued), m_policy(policy)
+        {
+            for (unsigned i = 0; i < std::max(1u, concurrency); ++i)
+                m_workers.push_back(std::thread(&BoundedExecutor::workerLoop, this));
+        }
+
+        BoundedExecutor(const BoundedExecutor &) = delete;
+        BoundedExecutor & operator=(const BoundedExecutor &) = delete;
+
+        // Queued calls are still run, then the workers exit
+        ~BoundedExecutor()
+        {
+            for (size_t i = 0; i < m_workers.size(); ++i)
+                m_queue.push(Job());
+            std::for_each(m_workers.begin(), m_workers.end(), std::mem_fn(&std::thread::join));
+        }
+
+        size_t rejected() const { return m_rejected.load(); }
+        size_t ranOnCaller() const { return m_callerRuns.load(); }
+
+        template <typename Fn, typename... Args>
+        auto submit(Fn && fn, Args &&... args)
+        {
+            auto boundTask = std::bind(std::forward<Fn>(fn), std::forward<Args>(args)...);
+            typedef decltype(boundTask()) Result;
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::move(boundTask));
+            std::future<Result> result = task->get_future();
+
+            // Reserve a place in the queue first, so the limit is exact
+            if (m_queued.fetch_add(1, std::memory_order_relaxed) >= m_maxQueued)
+            {
+                m_queued.fetch_sub(1, std::memory_order_relaxed);
+                if (m_policy == OverflowPolicy::Reject)
+                {
+                    m_rejected.fetch_add(1, std::memory_order_relaxed);
+                    throw std::system_error(std::make_error_code(std::errc::resource_unavailable_try_again),
+                        "BoundedExecutor queue is full");
+                }
+                m_callerRuns.fetch_add(1, std::memory_order_relaxed);
+                (*task)();
+                return result;
+            }
+            // The queue has room for every reserved place, so this never blocks
+            m_queue.push(Job([task]() { (*task)(); }));
+            return result;
+        }
+    };
+
+    // Shared executor for async(): enough threads for I/O bound calls, and callers slow down when it is overloaded
+    BoundedExecutor & defaultExecutor()
+    {
+        static BoundedExecutor executor(std::max(4u, 4 * std::thread::hardware_concurrency()), 10000,
+            BoundedExecutor::OverflowPolicy::CallerRuns);
+        return executor;
+    }
+
+    // Drop-in for std::async(). std::launch::deferred still means "run lazily in get()".
+    template <typename Fn, typename... Args>
+    auto async(std::launch policy, Fn && fn, Args &&... args)
+    {
+        if (policy == std::launch::deferred)
+            return std::async(std::launch::deferred, std::forward<Fn>(fn), std::forward<Args>(args)...);
+        return defaultExecutor().submit(std::forward<Fn>(fn), std::forward<Args>(args)...);
+    }
+
+    template <typename Fn, typename... Args,
+        typename = typename std::enable_if<!std::is_same<typename std::decay<Fn>::type, std::launch>::value>::type>
+    auto async(Fn && fn, Args &&... args)
+    {
+        // Qualified, an unqualified call would also find std::async() through the std::launch argument
+        return boundedAsync::async(std::launch::async | std::launch::deferred, std::forward<Fn>(fn), std::forward<Args>(args)...);
+    }
+
+    // Same as asyncTutorialAndExample's original test1(), with boundedAsync::async instead of std::async
+    void test()
+    {
+        system_clock::time_point start = system_clock::now();
+
+        std::future<std::string> resultFromDB = boundedAsync::async(std::launch::async, asyncTutorialAndExample::fetchDataFromDB, "Data");
+
+        //Fetch Data from File
+        std::string fileData = asyncTutorialAndExample::fetchDataFromFile("Data");
+
+        //Fetch Data from DB
+        std::string dbData = resultFromDB.get();
+
+        auto diff = duration_cast<std::chrono::seconds>(system_clock::now() - start).count();
+        std::cout << "Total Time Taken = " << diff << " Seconds" << std::endl;
+        std::cout << "Data = " << dbData << " :: " << fileData << std::endl;
+    }
+
+    // fetchDataFromDB() with a 1 ms wait instead of 5 seconds
+    std::string fetchDataFromDBQuick(std::string recvdData)
+    {
+        std::this_thread::sleep_for(milliseconds(1));
+        return "DB_" + recvdData;
+    }
+
+    // Resident memory in kB, from /proc (0 where that is not available)
+    long residentMemoryKb()
+    {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            if (line.compare(0, 6, "VmRSS:") == 0)
+                return std::stol(line.substr(6));
+        }
+        return 0;
+    }
+
+    // Samples the thread count and resident memory every millisecond while 'work' runs
+    template <typename Work>
+    void runAndMonitor(const char * name, Work work)
+    {
+        std::atomic<bool> done(false);
+        int peakThreads = 0;
+        long peakRssKb = 0;
+        std::thread monitor([&]() {
+            while (!done.load())
+            {
+                peakThreads = std::max(peakThreads, continuationFutures::currentThreadCount());
+                peakRssKb = std::max(peakRssKb, residentMemoryKb());
+                std::this_thread::sleep_for(milliseconds(1));
+            }
+        });
+        auto start = steady_clock::now();
+        std::string result = work();
+        auto elapsed = duration_cast<milliseconds>(steady_clock::now() - start).count();
+        done = true;
+        monitor.join();
+        std::cout << name << "  time = " << elapsed << " ms  peak threads = " << peakThreads
+            << "  peak RSS = " << peakRssKb << " kB  " << result << "\n";
+    }
+
+    void benchmarkBurst()
+    {
+        std::cout << "+++++++" << __FUNCTION__ << "+++++++\n";
+        const int calls = 100000;
+
+        runAndMonitor("std::async                     ", [calls]() {
+            std::vector<std::future<std::string>> results;
+            int failed = 0;
+            for (int i = 0; i < calls; ++i)
+            {
+                try
+                {
+                    results.push_back(std::async(std::launch::async, fetchDataFromDBQuick, "Data"));
+                }
+                catch (const std::system_error &)
+                {
+                    // Out of threads
+                    ++failed;
+                }
+            }
+            for (auto & result : results)
+                result.get();
+            return "failed = " + std::to_string(failed);
+        });
 
-        }, "Data");
+        runAndMonitor("BoundedExecutor 64 / CallerRuns", [calls]() {
+            BoundedExecutor executor(64, 1024, BoundedExecutor::OverflowPolicy::CallerRuns);
+            std::vector<std::future<std::string>> results;
+            results.reserve(calls);
+            for (int i = 0; i < calls; ++i)
+                results.push_back(executor.submit(fetchDataFromDBQuick, "Data"));
+            for (auto & result : results)
+                result.get();
+            return "ran on caller = " + std::to_string(executor.ranOnCaller());
+        });
 
-        std::cout << "lambda result: " << resultFromDB.get() << std::endl;
+        runAndMonitor("BoundedExecutor 64 / Reject    ", [calls]() {
+            BoundedExecutor executor(64, 1024, BoundedExecutor::OverflowPolicy::Reject);
+            std::vector<std::future<std::string>> results;
+            results.reserve(calls);
+            for (int i = 0; i < calls; ++i)
+            {
+                try
+                {
+                    results.push_back(executor.submit(fetchDataFromDBQuick, "Data"));
+                }
+                catch (const std::system_error &)
+                {
+                    // A real caller would back off or report an error here
+                }
+            }
+            for (auto & result : results)
+                result.get();
+            return "rejected = " + std::to_string(executor.rejected());
+        });
     }
 }
 
@@ -662,6 +3928,183 @@ namespace packaged_taskExampleAndTutorial {
     }
 }
 
+namespace smallBufferPackagedTask {
+    // std::packaged_task<> allocates its shared state and its callable on the heap.
+    // PackagedTask<> keeps the callable and its bound arguments in a smallBufferTask::Task<> and
+    // delivers the result through an inlinePromiseFuture::Slot<> provided by the caller,
+    // so creating, moving and running it doesn't allocate as long as the callable fits inline.
+    template <typename R>
+    class PackagedTask {
+        smallBufferTask::Task<R()> m_task;
+        inlinePromiseFuture::Promise<R> m_promise;
+    public:
+        template <typename Fn, typename... Args>
+        PackagedTask(inlinePromiseFuture::Slot<R> & slot, Fn && fn, Args &&... args)
+            : m_task(std::bind(std::forward<Fn>(fn), std::forward<Args>(args)...)), m_promise(slot)
+        {}
+
+        PackagedTask(PackagedTask &&) noexcept = default;
+
+        inlinePromiseFuture::Future<R> get_future()
+        {
+            return m_promise.get_future();
+        }
+
+        // Stores the value returned or the exception thrown by the callback
+        void operator()()
+        {
+            try
+            {
+                if constexpr (std::is_void<R>::value)
+                {
+                    m_task();
+                    m_promise.set_value();
+                }
+                else
+                    m_promise.set_value(m_task());
+            }
+            catch (...)
+            {
+                m_promise.set_exception(std::current_exception());
+            }
+        }
+    };
+
+    void test()
+    {
+        // The result slot lives on this stack frame
+        inlinePromiseFuture::Slot<std::string> slot;
+        PackagedTask<std::string> task(slot, packaged_taskExampleAndTutorial::getDataFromDB, "Arg");
+
+        inlinePromiseFuture::Future<std::string> result = task.get_future();
+
+        // Move-only like std::packaged_task<>, so move it to the thread
+        std::thread th(std::move(task));
+        th.join();
+
+        std::cout << result.get() << std::endl;
+    }
+
+    // Same as getDataFromDB() without the 5 second wait
+    std::string tagData(std::string recvdData)
+    {
+        return "DB_" + recvdData;
+    }
+
+    int square(int value)
+    {
+        return value * value;
+    }
+
+    void accumulate(int & total, int value)
+    {
+        total += value;
+    }
+
+    // Creates and runs tasks on this thread and counts the heap allocations it takes.
+    // The payloads are ints so that only the task machinery can allocate, not the values.
+    void allocationTest()
+    {
+        std::cout << "+++++++" << __FUNCTION__ << "+++++++\n";
+        const int count = 1000;
+
+        long long before = allocationCounting::count();
+        for (int i = 0; i < count; ++i)
+        {
+            std::packaged_task<int(int)> task(square);
+            std::future<int> result = task.get_future();
+            task(i);
+            result.get();
+        }
+        long long stdAllocations = allocationCounting::count() - before;
+
+        inlinePromiseFuture::Slot<int> slot;
+        before = allocationCounting::count();
+        for (int i = 0; i < count; ++i)
+        {
+            slot.reset();
+            PackagedTask<int> task(slot, square, i);
+            inlinePromiseFuture::Future<int> result = task.get_future();
+            PackagedTask<int> movedTask(std::move(task));
+            movedTask();
+            if (result.get() != i * i)
+                std::cout << "Error PackagedTask returned a wrong value for " << i << std::endl;
+        }
+        long long taskAllocations = allocationCounting::count() - before;
+
+        // Same with no result, the future only reports completion
+        inlinePromiseFuture::Slot<void> doneSlot;
+        int total = 0;
+        before = allocationCounting::count();
+        for (int i = 0; i < count; ++i)
+        {
+            doneSlot.reset();
+            PackagedTask<void> task(doneSlot, accumulate, std::ref(total), i);
+            inlinePromiseFuture::Future<void> done = task.get_future();
+            PackagedTask<void> movedTask(std::move(task));
+            movedTask();
+            done.get();
+        }
+        long long voidTaskAllocations = allocationCounting::count() - before;
+
+        std::cout << "std::packaged_task : " << stdAllocations / double(count) << " allocations per task\n";
+        std::cout << "PackagedTask       : " << taskAllocations / double(count) << " allocations per task\n";
+        std::cout << "PackagedTask<void> : " << voidTaskAllocations / double(count) << " allocations per task\n";
+        if (taskAllocations != 0)
+            std::cout << "Error PackagedTask allocated " << taskAllocations << " times" << std::endl;
+        if (voidTaskAllocations != 0)
+            std::cout << "Error PackagedTask<void> allocated " << voidTaskAllocations << " times" << std::endl;
+        if (total != count * (count - 1) / 2)
+            std::cout << "Error PackagedTask<void> ran " << total << " instead of " << count * (count - 1) / 2 << std::endl;
+
+        // A callable that is too big for the inline buffer still works, it just goes to the heap
+        char big[256] = "Big";
+        smallBufferTask::Task<std::string()> bigTask([big]() { return std::string(big); });
+        std::cout << "Big callable result = " << bigTask() << std::endl;
+    }
+
+    // Submits 'count' tasks to the pool and waits for all of them
+    void benchmarkSubmission()
+    {
+        std::cout << "+++++++" << __FUNCTION__ << "+++++++\n";
+        const int count = 100000;
+        workStealingThreadPool::ThreadPool & pool = workStealingThreadPool::defaultPool();
+
+        std::vector<std::future<std::string>> stdResults;
+        stdResults.reserve(count);
+        long long before = allocationCounting::count();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; ++i)
+            stdResults.push_back(pool.submit(tagData, "Arg"));
+        for (auto & result : stdResults)
+            result.get();
+        std::chrono::duration<double> stdTime = std::chrono::steady_clock::now() - start;
+        long long stdAllocations = allocationCounting::count() - before;
+
+        // The result slots are the caller's storage, allocated once up front and reused
+        std::unique_ptr<inlinePromiseFuture::Slot<std::string>[]> slots(new inlinePromiseFuture::Slot<std::string>[count]);
+        std::vector<inlinePromiseFuture::Future<std::string>> results;
+        results.reserve(count);
+        before = allocationCounting::count();
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; ++i)
+        {
+            PackagedTask<std::string> task(slots[i], tagData, "Arg");
+            results.push_back(task.get_future());
+            pool.execute(std::move(task));
+        }
+        for (auto & result : results)
+            result.get();
+        std::chrono::duration<double> taskTime = std::chrono::steady_clock::now() - start;
+        long long taskAllocations = allocationCounting::count() - before;
+
+        std::cout << "std::packaged_task : " << count / stdTime.count() << " tasks/s  "
+            << stdAllocations / double(count) << " allocations per task\n";
+        std::cout << "PackagedTask       : " << count / taskTime.count() << " tasks/s  "
+            << taskAllocations / double(count) << " allocations per task\n";
+    }
+}
+
 
 int main(int   argc,
     char *argv[])
@@ -670,6 +4113,10 @@ int main(int   argc,
     //threeDifferentWaysToCreateTheads::createThreadUsingLambdaFunctions();
     //threeDifferentWaysToCreateTheads::differentiatingBetweenThreads();
 
+    //asyncLogging::benchmarkAgainstCout();
+
+    //workStealingThreadPool::benchmarkSpawnVsPool();
+
     //joiningAndDetachingThreads::joiningThreads();
     //joiningAndDetachingThreads::detachingThreads();
 
@@ -680,17 +4127,35 @@ int main(int   argc,
     //dataSharingAndRaceConditions::practicalExampleOfRaceCondition();
 
     // usingMutexToFixRaceConditions::test();
+    //readMostlyPublication::benchmarkReaders();
+
+    //shardedCounterWallet::test();
+    //shardedCounterWallet::benchmarkScaling();
+    //threadPlacement::benchmarkWalletPlacement();
 
     //eventHandling::options1Test();
     //eventHandling::options2Test();
+    //spinThenParkEvent::benchmarkWakeLatency();
+
+    //boundedMpmcQueue::stressTest();
+    //boundedMpmcQueue::benchmarkThroughput();
 
     //futurePromiseAndReturningValue::test();
+    //inlinePromiseFuture::test();
+    //inlinePromiseFuture::benchmarkHandOff();
 
     //asyncTutorialAndExample::test1();
     //asyncTutorialAndExample::test2();
     //asyncTutorialAndExample::test3();
 
+    //boundedAsync::test();
+    //boundedAsync::benchmarkBurst();
+
     packaged_taskExampleAndTutorial::test();
 
+    //smallBufferPackagedTask::test();
+    //smallBufferPackagedTask::allocationTest();
+    //smallBufferPackagedTask::benchmarkSubmission();
+
     return 0;
 }
@@ -1,16 +1,405 @@
 #include <iostream>
 #include <thread>
 #include <future>
+#include <functional>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <memory>
+#include <deque>
+#include <queue>
+#include <string>
+#include <fstream>
+#include <cstdlib>
+#include <ucontext.h>
+#include <sys/mman.h>
 
+// Hierarchical timer wheel
+// Periodic work written as "do the work, sleep_for(1000 ms), repeat" keeps a whole thread busy doing nothing.
+// A timer service runs all the periodic and delayed callbacks from a single thread instead.
+
+// The timers are kept in a hierarchy of wheels like the hands of a clock, with a tick of 1 ms,
+//    level 0 : 256 slots of 1 tick each         (up to 256 ms ahead)
+//    level 1 :  64 slots of 256 ticks each      (up to 16 seconds ahead)
+//    level 2 :  64 slots of 16384 ticks each    (up to 17 minutes ahead)
+//    level 3 :  64 slots of 1048576 ticks each  (up to 18 hours ahead, later timers wait in the last slot)
+// A timer goes into the slot of its expiry time on the finest level that reaches that far.
+// Whenever level 0 has gone round once, the next slot of level 1 is emptied and its timers
+// are spread over level 0 (and so on upwards), so every timer is moved at most once per level.
+// Every slot is a doubly linked list, so adding and cancelling a timer is O(1).
+class TimerWheel
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+    typedef std::uint64_t TimerId;      // index of the timer in the low 32 bits, its generation in the high 32 bits
+
+private:
+    enum { Level0Bits = 8, LevelBits = 6, Levels = 4 };
+    enum { Level0Size = 1 << Level0Bits, LevelSize = 1 << LevelBits };
+    enum { ListCount = Level0Size + (Levels - 1) * LevelSize };
+    static constexpr std::uint64_t MaxDelta = 1ull << (Level0Bits + (Levels - 1) * LevelBits);
+
+    struct Node
+    {
+        std::uint64_t expires = 0;      // tick at which the timer is due
+        std::uint64_t interval = 0;     // in ticks, 0 for one-shot timers
+        std::function<void()> callback;
+        std::uint32_t generation = 0;   // bumped on every reuse, so old TimerIds can't cancel a new timer
+        int prev = -1;
+        int next = -1;
+        int list = -1;                  // list the node is linked in, -1 if none
+        bool active = false;
+        bool running = false;
+        bool cancelled = false;
+    };
+
+    std::mutex m_mutex;
+    std::condition_variable m_condVar;
+    std::condition_variable m_callbacksDone;    // a batch of callbacks has finished running
+    std::vector<Node> m_nodes;
+    std::vector<int> m_freeNodes;
+    int m_heads[ListCount];
+    std::uint64_t m_currentTick;        // next tick to be processed
+    std::uint64_t m_wakeTick;           // tick the timer thread sleeps until, add() wakes it for an earlier timer
+    size_t m_activeCount;
+    const Clock::time_point m_start;
+    bool m_done;
+    std::thread m_thread;
+
+    std::uint64_t tickAt(Clock::time_point time) const
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(time - m_start).count();
+    }
+
+    static std::uint64_t toTicks(Clock::duration duration)
+    {
+        // Round up, a timer must never fire early
+        auto ticks = std::chrono::duration_cast<std::chrono::milliseconds>(duration + std::chrono::milliseconds(1) - Clock::duration(1)).count();
+        return ticks > 0 ? ticks : 0;
+    }
+
+    int listFor(std::uint64_t expires) const
+    {
+        if (expires < m_currentTick)
+            expires = m_currentTick;
+        std::uint64_t delta = expires - m_currentTick;
+        if (delta < Level0Size)
+            return static_cast<int>(expires & (Level0Size - 1));
+        if (delta >= MaxDelta)
+        {
+            // Too far ahead, park it in the last slot that can be reached and place it again from there
+            delta = MaxDelta - 1;
+            expires = m_currentTick + delta;
+        }
+        int level = 1;
+        int shift = Level0Bits;
+        while (delta >= (1ull << (shift + LevelBits)))
+        {
+            ++level;
+            shift += LevelBits;
+        }
+        return Level0Size + (level - 1) * LevelSize + static_cast<int>((expires >> shift) & (LevelSize - 1));
+    }
+
+    void link(int index)
+    {
+        Node & node = m_nodes[index];
+        node.list = listFor(node.expires);
+        node.prev = -1;
+        node.next = m_heads[node.list];
+        if (node.next >= 0)
+            m_nodes[node.next].prev = index;
+        m_heads[node.list] = index;
+    }
+
+    void unlink(int index)
+    {
+        Node & node = m_nodes[index];
+        if (node.prev >= 0)
+            m_nodes[node.prev].next = node.next;
+        else
+            m_heads[node.list] = node.next;
+        if (node.next >= 0)
+            m_nodes[node.next].prev = node.prev;
+        node.list = -1;
+    }
+
+    void release(int index)
+    {
+        Node & node = m_nodes[index];
+        node.callback = nullptr;
+        node.active = false;
+        ++node.generation;
+        m_freeNodes.push_back(index);
+        --m_activeCount;
+    }
+
+    // Moves all timers of one slot of a higher level down to the finer levels
+    void cascade(int list)
+    {
+        int index = m_heads[list];
+        m_heads[list] = -1;
+        while (index >= 0)
+        {
+            int next = m_nodes[index].next;
+            link(index);
+            index = next;
+        }
+    }
+
+    void advanceOneTick(std::vector<int> & fired)
+    {
+        int slot = static_cast<int>(m_currentTick & (Level0Size - 1));
+        if (slot == 0)
+        {
+            for (int level = 1; level < Levels; ++level)
+            {
+                int shift = Level0Bits + (level - 1) * LevelBits;
+                int levelSlot = static_cast<int>((m_currentTick >> shift) & (LevelSize - 1));
+                cascade(Level0Size + (level - 1) * LevelSize + levelSlot);
+                if (levelSlot != 0)
+                    break;
+            }
+        }
+
+        int index = m_heads[slot];
+        m_heads[slot] = -1;
+        while (index >= 0)
+        {
+            int next = m_nodes[index].next;
+            m_nodes[index].list = -1;
+            if (m_nodes[index].expires > m_currentTick)
+                link(index);
+            else
+                fired.push_back(index);
+            index = next;
+        }
+        ++m_currentTick;
+    }
+
+    // The first tick from m_currentTick on that has timers in its slot of level 0, or else the next time
+    // level 0 goes round and timers come down from the higher levels. Nothing can happen before it.
+    std::uint64_t nextEventTick() const
+    {
+        // The cascade of the current tick is still to be done
+        if ((m_currentTick & (Level0Size - 1)) == 0)
+            return m_currentTick;
+        std::uint64_t boundary = (m_currentTick | (Level0Size - 1)) + 1;
+        for (std::uint64_t tick = m_currentTick; tick < boundary; ++tick)
+        {
+            if (m_heads[tick & (Level0Size - 1)] >= 0)
+                return tick;
+        }
+        return boundary;
+    }
+
+    void run()
+    {
+        std::vector<int> fired;
+        std::vector<std::function<void()>> callbacks;
+        std::unique_lock<std::mutex> mlock(m_mutex);
+        while (!m_done)
+        {
+            if (m_activeCount == 0)
+            {
+                m_wakeTick = ~std::uint64_t(0);
+                m_condVar.wait(mlock);
+                continue;
+            }
+            // Sleep through the empty ticks, a 1 s periodic timer doesn't need 1000 wake ups a second
+            std::uint64_t nowTick = tickAt(Clock::now());
+            std::uint64_t nextTick = nextEventTick();
+            if (nextTick > nowTick)
+            {
+                m_wakeTick = nextTick;
+                m_condVar.wait_until(mlock, m_start + std::chrono::milliseconds(nextTick));
+                continue;
+            }
+
+            while (m_currentTick <= nowTick)
+                advanceOneTick(fired);
+
+            // Run the callbacks without holding the lock, they may add or cancel timers
+            for (int index : fired)
+            {
+                m_nodes[index].running = true;
+                callbacks.push_back(std::move(m_nodes[index].callback));
+            }
+            mlock.unlock();
+            for (auto & callback : callbacks)
+                callback();
+            mlock.lock();
+
+            for (size_t i = 0; i < fired.size(); ++i)
+            {
+                Node & node = m_nodes[fired[i]];
+                node.running = false;
+                if (node.interval && !node.cancelled)
+                {
+                    // Next period counts from when it was due, not from when it ran, so it doesn't drift
+                    node.expires = std::max(node.expires + node.interval, m_currentTick);
+                    node.callback = std::move(callbacks[i]);
+                    link(fired[i]);
+                }
+                else
+                {
+                    release(fired[i]);
+                }
+            }
+            fired.clear();
+            callbacks.clear();
+            m_callbacksDone.notify_all();
+        }
+    }
+
+    bool cancelLocked(TimerId id)
+    {
+        std::uint32_t index = static_cast<std::uint32_t>(id);
+        if (index >= m_nodes.size())
+            return false;
+        Node & node = m_nodes[index];
+        if (!node.active || node.generation != static_cast<std::uint32_t>(id >> 32) || node.cancelled)
+            return false;
+        if (node.running)
+        {
+            // A one-shot timer that is running has fired, only a periodic one can still be stopped
+            if (node.interval == 0)
+                return false;
+            node.cancelled = true;
+            return true;
+        }
+        unlink(index);
+        release(index);
+        return true;
+    }
+
+    TimerId add(Clock::duration delay, Clock::duration interval, std::function<void()> callback)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        Clock::time_point now = Clock::now();
+        std::uint64_t nowTick = tickAt(now);
+        // Nothing is pending, so the wheel can jump straight to the current time
+        if (m_activeCount == 0 && m_currentTick < nowTick)
+            m_currentTick = nowTick;
+
+        int index;
+        if (m_freeNodes.empty())
+        {
+            index = static_cast<int>(m_nodes.size());
+            m_nodes.emplace_back();
+        }
+        else
+        {
+            index = m_freeNodes.back();
+            m_freeNodes.pop_back();
+        }
+        Node & node = m_nodes[index];
+        node.expires = toTicks(now + delay - m_start);
+        node.interval = interval.count() > 0 ? std::max<std::uint64_t>(1, toTicks(interval)) : 0;
+        node.callback = std::move(callback);
+        node.active = true;
+        node.running = false;
+        node.cancelled = false;
+        link(index);
+        // The timer thread sleeps till the first timer it knew of, or forever if there was none
+        if (++m_activeCount == 1 || node.expires < m_wakeTick)
+            m_condVar.notify_one();
+        return (static_cast<TimerId>(node.generation) << 32) | static_cast<std::uint32_t>(index);
+    }
+
+public:
+    TimerWheel() : m_currentTick(0), m_wakeTick(~std::uint64_t(0)), m_activeCount(0), m_start(Clock::now()), m_done(false)
+    {
+        std::fill(m_heads, m_heads + ListCount, -1);
+        m_thread = std::thread(&TimerWheel::run, this);
+    }
+
+    TimerWheel(const TimerWheel &) = delete;
+    TimerWheel & operator=(const TimerWheel &) = delete;
+
+    // Timers that are still pending are dropped
+    ~TimerWheel()
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_done = true;
+        }
+        m_condVar.notify_one();
+        m_thread.join();
+    }
+
+    // Calls 'callback' once on the timer thread after 'delay'
+    TimerId scheduleAfter(Clock::duration delay, std::function<void()> callback)
+    {
+        return add(delay, Clock::duration::zero(), std::move(callback));
+    }
+
+    // Calls 'callback' every 'interval' on the timer thread, the first time after 'firstDelay'
+    TimerId scheduleEvery(Clock::duration interval, std::function<void()> callback, Clock::duration firstDelay)
+    {
+        return add(firstDelay, interval, std::move(callback));
+    }
+
+    TimerId scheduleEvery(Clock::duration interval, std::function<void()> callback)
+    {
+        return add(interval, interval, std::move(callback));
+    }
+
+    // Returns false if the timer was cancelled before, or if it is a one-shot timer that has fired
+    // or is running right now. A callback that is running right now finishes, but a periodic timer won't run again.
+    bool cancel(TimerId id)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return cancelLocked(id);
+    }
+
+    // Like cancel() (and returns the same), but if the callback is running right now, waits till it has finished.
+    // Once it returns the callback never runs again, so it may use state that is destroyed next.
+    // A callback that cancels its own timer doesn't wait for itself.
+    bool cancelAndWait(TimerId id)
+    {
+        std::unique_lock<std::mutex> mlock(m_mutex);
+        bool cancelled = cancelLocked(id);
+        std::uint32_t index = static_cast<std::uint32_t>(id);
+        std::uint32_t generation = static_cast<std::uint32_t>(id >> 32);
+        if (index < m_nodes.size() && std::this_thread::get_id() != m_thread.get_id())
+        {
+            m_callbacksDone.wait(mlock, [&]() {
+                return m_nodes[index].generation != generation || !m_nodes[index].running;
+            });
+        }
+        return cancelled;
+    }
+
+    size_t pendingTimers()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_activeCount;
+    }
+
+    static TimerWheel & instance()
+    {
+        static TimerWheel timers;
+        return timers;
+    }
+};
+
+// The periodic work is done by a timer, the thread only waits for the exit signal
 void threadFunction(std::future<void> futureObj)
 {
     std::cout << "Thread Start" << std::endl;
-    while (futureObj.wait_for(std::chrono::milliseconds(1)) == std::future_status::timeout)
-    {
+    TimerWheel::TimerId work = TimerWheel::instance().scheduleEvery(std::chrono::milliseconds(1000), []() {
         std::cout << "Doing Some Work" << std::endl;
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    }, std::chrono::milliseconds(0));
 
-    }
+    // Blocks till value in future object is available, no polling
+    futureObj.wait();
+    TimerWheel::instance().cancelAndWait(work);
     std::cout << "Thread End" << std::endl;
 
 }
@@ -42,33 +431,354 @@ void stoppingThreadUsingFuture()
     std::cout << "Exiting Main Function" << std::endl;
 }
 
+// Stop tokens
+// Checking a std::future with wait_for(0) locks the mutex of its shared state on every call,
+// which is far too expensive for the condition of a hot loop, and a future can't be shared by several tasks.
+// A StopSource owns a shared stop state and hands out StopTokens, which can be copied to any number of tasks.
+//    1.) StopToken::stopRequested() is a single relaxed atomic load.
+//    2.) A StopCallback registers a function that runs when stop is requested
+//        (or right away, if it already was), e.g. to wake a task that is blocked somewhere.
+//    3.) Destroying a StopCallback unregisters it. If the callback is running in another
+//        thread at that moment, the destructor waits for it to finish.
+class StopCallbackBase
+{
+    friend class StopState;
+    StopCallbackBase * m_prev = nullptr;
+    StopCallbackBase * m_next = nullptr;
+    bool m_registered = false;
+
+protected:
+    virtual void invoke() = 0;
+    ~StopCallbackBase() {}
+};
+
+class StopState
+{
+    std::atomic<bool> m_requested;
+    std::mutex m_mutex;
+    std::condition_variable m_callbackDone;
+    StopCallbackBase * m_callbacks;
+    StopCallbackBase * m_running;       // callback being invoked by requestStop() right now
+    std::thread::id m_requester;
+
+public:
+    StopState() : m_requested(false), m_callbacks(nullptr), m_running(nullptr) {}
+
+    bool stopRequested() const
+    {
+        return m_requested.load(std::memory_order_relaxed);
+    }
+
+    // Returns false if stop was requested before
+    bool requestStop()
+    {
+        std::unique_lock<std::mutex> mlock(m_mutex);
+        if (m_requested.load(std::memory_order_relaxed))
+            return false;
+        m_requested.store(true, std::memory_order_release);
+        m_requester = std::this_thread::get_id();
+        while (m_callbacks)
+        {
+            StopCallbackBase * callback = m_callbacks;
+            m_callbacks = callback->m_next;
+            if (m_callbacks)
+                m_callbacks->m_prev = nullptr;
+            callback->m_registered = false;
+            m_running = callback;
+            mlock.unlock();
+            callback->invoke();
+            mlock.lock();
+            m_running = nullptr;
+            m_callbackDone.notify_all();
+        }
+        return true;
+    }
+
+    // Returns false if stop was already requested, then the callback isn't added
+    bool add(StopCallbackBase * callback)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (m_requested.load(std::memory_order_relaxed))
+            return false;
+        callback->m_prev = nullptr;
+        callback->m_next = m_callbacks;
+        if (m_callbacks)
+            m_callbacks->m_prev = callback;
+        m_callbacks = callback;
+        callback->m_registered = true;
+        return true;
+    }
+
+    void remove(StopCallbackBase * callback)
+    {
+        std::unique_lock<std::mutex> mlock(m_mutex);
+        if (callback->m_registered)
+        {
+            if (callback->m_prev)
+                callback->m_prev->m_next = callback->m_next;
+            else
+                m_callbacks = callback->m_next;
+            if (callback->m_next)
+                callback->m_next->m_prev = callback->m_prev;
+            callback->m_registered = false;
+            return;
+        }
+        // A callback that removes itself while it runs must not wait for itself
+        if (m_running == callback && m_requester != std::this_thread::get_id())
+            m_callbackDone.wait(mlock, [&]() { return m_running != callback; });
+    }
+};
+
+class StopToken
+{
+    template <typename Callback> friend class StopCallback;
+    std::shared_ptr<StopState> m_state;
+
+public:
+    StopToken() {}
+    explicit StopToken(std::shared_ptr<StopState> state) : m_state(std::move(state)) {}
+
+    bool stopRequested() const
+    {
+        return m_state && m_state->stopRequested();
+    }
+
+    // False for a default constructed token, nobody can ever stop it
+    bool stopPossible() const
+    {
+        return m_state != nullptr;
+    }
+};
+
+class StopSource
+{
+    std::shared_ptr<StopState> m_state;
+
+public:
+    StopSource() : m_state(std::make_shared<StopState>()) {}
+
+    StopToken getToken() const
+    {
+        return StopToken(m_state);
+    }
+
+    bool stopRequested() const
+    {
+        return m_state && m_state->stopRequested();
+    }
+
+    bool requestStop()
+    {
+        return m_state && m_state->requestStop();
+    }
+};
+
+template <typename Callback>
+class StopCallback : private StopCallbackBase
+{
+    std::shared_ptr<StopState> m_state;
+    Callback m_callback;
+
+    void invoke() override
+    {
+        m_callback();
+    }
+
+public:
+    StopCallback(const StopToken & token, Callback callback) : m_state(token.m_state), m_callback(std::move(callback))
+    {
+        if (m_state && !m_state->add(this))
+        {
+            m_state.reset();
+            m_callback();
+        }
+    }
+
+    StopCallback(const StopCallback &) = delete;
+    StopCallback & operator=(const StopCallback &) = delete;
+
+    ~StopCallback()
+    {
+        if (m_state)
+            m_state->remove(this);
+    }
+};
+
+template <typename Callback>
+StopCallback<Callback> makeStopCallback(const StopToken & token, Callback callback)
+{
+    return StopCallback<Callback>(token, std::move(callback));
+}
+
+// A task running as a fiber (see FiberScheduler) must not block its worker thread,
+// it waits by handing the thread back to the scheduler
+bool inFiber();
+void yieldFiber();
+bool sleepFiber(std::chrono::steady_clock::duration duration, const StopToken & token);
+
+// Blocks till stop is requested on the token
+void waitForStop(const StopToken & token)
+{
+    if (inFiber())
+    {
+        while (!token.stopRequested())
+            sleepFiber(std::chrono::hours(24), token);
+        return;
+    }
+    std::mutex mutex;
+    std::condition_variable condVar;
+    bool stopped = false;
+    auto onStop = makeStopCallback(token, [&]() {
+        std::lock_guard<std::mutex> guard(mutex);
+        stopped = true;
+        condVar.notify_one();
+    });
+    std::unique_lock<std::mutex> mlock(mutex);
+    condVar.wait(mlock, [&]() { return stopped; });
+}
+
+// Interruptible waits
+// A task that sleeps or waits between its work steps only notices a stop request when it wakes up,
+// so its stop latency is as long as its sleep. These waits return as soon as stop is requested.
+// They all return true if they ended normally and false if they were interrupted by the stop request.
+
+// Sleeps for 'duration' unless stop is requested first
+template <typename Rep, typename Period>
+bool sleepFor(const std::chrono::duration<Rep, Period> & duration, const StopToken & token)
+{
+    if (inFiber())
+        return sleepFiber(std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration), token);
+    std::mutex mutex;
+    std::condition_variable condVar;
+    auto onStop = makeStopCallback(token, [&]() {
+        std::lock_guard<std::mutex> guard(mutex);
+        condVar.notify_one();
+    });
+    std::unique_lock<std::mutex> mlock(mutex);
+    return !condVar.wait_for(mlock, duration, [&]() { return token.stopRequested(); });
+}
+
+// condVar.wait(lock, predicate) that also returns when stop is requested, then it returns predicate().
+// The stop callback locks the same mutex to notify, so stop must not be requested while holding it.
+// The lock is released for a moment at the start and at the end, to add and remove the callback.
+template <typename Predicate>
+bool waitFor(std::condition_variable & condVar, std::unique_lock<std::mutex> & lock, const StopToken & token, Predicate predicate)
+{
+    bool result;
+    lock.unlock();
+    {
+        std::mutex & mutex = *lock.mutex();
+        auto onStop = makeStopCallback(token, [&]() {
+            std::lock_guard<std::mutex> guard(mutex);
+            condVar.notify_all();
+        });
+        lock.lock();
+        condVar.wait(lock, [&]() { return predicate() || token.stopRequested(); });
+        result = predicate();
+        lock.unlock();
+    }
+    lock.lock();
+    return result;
+}
+
+// Waits for the future to get its value unless stop is requested first.
+// Only the promise can wake a thread blocked on a std::future, so this waits in short slices
+// and checks the token in between, the stop latency is at most one slice.
+template <typename T>
+bool waitFor(const std::future<T> & future, const StopToken & token,
+             std::chrono::microseconds slice = std::chrono::milliseconds(1))
+{
+    while (future.wait_for(slice) == std::future_status::timeout)
+    {
+        if (token.stopRequested())
+            return false;
+    }
+    return true;
+}
+
+// Cancellation scopes
+// Shutting down a subsystem shouldn't mean calling stop() on every one of its tasks.
+// Scopes form a tree: a scope made with a parent's token registers a StopCallback on the parent,
+// so cancelling a scope stops all of its child scopes and tasks, and theirs, each in O(children).
+// Attaching a child (creating it) and detaching it (destroying it or detach()) are O(1) list operations
+// under the parent's lock, they may happen in other threads while the parent is being cancelled.
+class CancellationScope
+{
+    struct StopChild {
+        StopSource child;
+        void operator()() { child.requestStop(); }
+    };
+    typedef StopCallback<StopChild> ParentLink;
+
+    StopSource m_stopSource;
+    std::unique_ptr<ParentLink> m_parentLink;
+
+public:
+    // A root scope, it's only cancelled by cancel()
+    CancellationScope() {}
+
+    // Cancelled by cancel() or when the parent is, right away if the parent already was
+    explicit CancellationScope(const StopToken & parent)
+        : m_parentLink(new ParentLink(parent, StopChild{ m_stopSource }))
+    {}
+
+    CancellationScope(CancellationScope &&) = default;
+    CancellationScope & operator=(CancellationScope &&) = default;
+
+    StopToken getToken() const
+    {
+        return m_stopSource.getToken();
+    }
+
+    bool cancelled() const
+    {
+        return m_stopSource.stopRequested();
+    }
+
+    // Stops this scope and everything below it, returns false if it was cancelled before
+    bool cancel()
+    {
+        return m_stopSource.requestStop();
+    }
+
+    // From now on the parent's cancellation doesn't reach this scope any more
+    void detach()
+    {
+        m_parentLink.reset();
+    }
+};
+
 //Creating a Stoppable Task
-//Stoppable class that encapsulate the promise and future object
+//Stoppable class that encapsulate the stop source
 
 /*
- * Class that encapsulates promise and future object and
- * provides APT to set exit signal for the thread
+ * Class that encapsulates a cancellation scope and
+ * provides API to request the thread to stop.
+ * It used to keep a promise / future pair, stopRequested() had to lock the future's mutex every time.
+ * Other tasks can share the stop request through getStopToken().
  */
 class Stoppable
 {
-    std::promise<void> exitSignal;
-    std::future<void> futureObj;
+    CancellationScope scope;
 public:
-    Stoppable() : futureObj(exitSignal.get_future())
+    Stoppable()
+    {
+    }
+    //The task is also stopped when 'parent' is, e.g. the token of the subsystem's CancellationScope
+    explicit Stoppable(const StopToken & parent) : scope(parent)
     {
     }
-    Stoppable(Stoppable && obj) : exitSignal(std::move(obj.exitSignal)), futureObj(std::move(obj.futureObj))
+    Stoppable(Stoppable && obj) : scope(std::move(obj.scope))
     {
         std::cout << "Move Constructor is called\n";
     }
     Stoppable & operator=(Stoppable && obj)
     {
         std::cout << "Move Assignment is called\n";
-        exitSignal = std::move(obj.exitSignal);
-        futureObj = std::move(obj.futureObj);
+        scope = std::move(obj.scope);
         return *this;
     }
-    ~Stoppable()
+    virtual ~Stoppable()
     {}
 
     //Task need to provide definition for this function
@@ -81,21 +791,31 @@ public:
         run();
     }
 
-    //Checks if thread is requested to stop
-    bool stopRequested()
+    //Token that is stopped together with this task
+    StopToken getStopToken() const
     {
-        //checks if value in future object is avaiable
-        if (futureObj.wait_for(std::chrono::milliseconds(0)) == std::future_status::timeout)
-        {
-            return false;
-        }
-        return true;
+        return scope.getToken();
+    }
+
+    //Blocks till the thread is requested to stop
+    void waitForStop()
+    {
+        ::waitForStop(getStopToken());
     }
 
-    //Request the thread to stop by setting value in promise object
+    //Checks if thread is requested to stop, a single atomic load.
+    //In a fiber it is also the point where other fibers get their turn.
+    bool stopRequested() const
+    {
+        if (inFiber())
+            yieldFiber();
+        return scope.cancelled();
+    }
+
+    //Request the thread to stop, runs the stop callbacks
     void stop()
     {
-        exitSignal.set_value();
+        scope.cancel();
     }
 };
 
@@ -105,18 +825,26 @@ public:
 */
 class MyTask : public Stoppable {
 public:
+    MyTask()
+    {
+    }
+    explicit MyTask(const StopToken & parent) : Stoppable(parent)
+    {
+    }
+
     // Function to be executed by thread function
     void run()
     {
         std::cout << "Task Start" << std::endl;
 
-        // Check if thread is requested to stop ?
-        while (stopRequested() == false)
-        {
+        // The work runs every second on the timer thread
+        TimerWheel::TimerId work = TimerWheel::instance().scheduleEvery(std::chrono::milliseconds(1000), []() {
             std::cout << "Doing Some Work" << std::endl;
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        }, std::chrono::milliseconds(0));
 
-        }
+        // Wait till thread is requested to stop, then stop the work
+        waitForStop();
+        TimerWheel::instance().cancelAndWait(work);
         std::cout << "Task End" << std::endl;
     }
 };
@@ -144,10 +872,974 @@ void creatingAStoppableTask()
 }
 
 
+// Shutting down a group of tasks with a deadline
+// task.stop(); th.join(); waits forever if the task doesn't return, and not waiting gives up on its work.
+// A StoppableGroup runs every Stoppable it is given on a thread of its own and shuts them down in two phases,
+//    1.) it stops accepting new tasks and asks every task to stop, so they finish the work they are doing,
+//    2.) it waits for them until the drain deadline, then gives the late ones a grace time.
+// Tasks still running after that are abandoned: their threads are detached and keep the task alive until it returns.
+class StoppableGroup
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct ShutdownReport {
+        int finished = 0;       // returned before the drain deadline
+        int timedOut = 0;       // returned after the drain deadline, but within the grace time
+        int abandoned = 0;      // still running after the grace time
+        Clock::duration elapsed = Clock::duration::zero();
+    };
+
+private:
+    // Shared with the task threads, an abandoned thread may outlive the group
+    struct State {
+        std::mutex mutex;
+        std::condition_variable condVar;
+        int running = 0;
+    };
+
+    struct Member {
+        std::unique_ptr<Stoppable> task;
+        bool done = false;
+    };
+
+    std::shared_ptr<State> m_state;
+    std::vector<std::shared_ptr<Member>> m_members;
+    std::vector<std::thread> m_threads;
+    bool m_accepting;
+
+public:
+    StoppableGroup() : m_state(std::make_shared<State>()), m_accepting(true) {}
+
+    StoppableGroup(const StoppableGroup &) = delete;
+    StoppableGroup & operator=(const StoppableGroup &) = delete;
+
+    ~StoppableGroup()
+    {
+        shutdown(std::chrono::seconds(10), std::chrono::seconds(1));
+    }
+
+    // Runs the task on a thread of its own, returns false once the group is shutting down
+    bool start(std::unique_ptr<Stoppable> task)
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        if (!m_accepting)
+            return false;
+        auto member = std::make_shared<Member>();
+        member->task = std::move(task);
+        m_members.push_back(member);
+        m_state->running++;
+        std::shared_ptr<State> state = m_state;
+        m_threads.emplace_back([state, member]() {
+            member->task->run();
+            std::lock_guard<std::mutex> guard(state->mutex);
+            member->done = true;
+            state->running--;
+            state->condVar.notify_all();
+        });
+        return true;
+    }
+
+    ShutdownReport shutdown(Clock::duration drainTime, Clock::duration graceTime)
+    {
+        ShutdownReport report;
+        auto start = Clock::now();
+        {
+            std::lock_guard<std::mutex> guard(m_state->mutex);
+            if (!m_accepting)
+                return report;
+            m_accepting = false;
+        }
+
+        // Phase 1 : no more tasks can be added, ask all of them to stop
+        for (auto & member : m_members)
+            member->task->stop();
+
+        // Phase 2 : wait for them to return, until the drain deadline and then until the end of the grace time
+        std::vector<char> finishedInTime(m_members.size());
+        std::vector<char> returned(m_members.size());
+        {
+            std::unique_lock<std::mutex> mlock(m_state->mutex);
+            m_state->condVar.wait_until(mlock, start + drainTime, [&]() { return m_state->running == 0; });
+            for (size_t i = 0; i < m_members.size(); ++i)
+                finishedInTime[i] = m_members[i]->done;
+            m_state->condVar.wait_until(mlock, start + drainTime + graceTime, [&]() { return m_state->running == 0; });
+            for (size_t i = 0; i < m_members.size(); ++i)
+            {
+                if (finishedInTime[i])
+                    report.finished++;
+                else if (m_members[i]->done)
+                    report.timedOut++;
+                else
+                    report.abandoned++;
+            }
+            // The threads of the abandoned tasks must not be joined below
+            for (size_t i = 0; i < m_members.size(); ++i)
+                returned[i] = m_members[i]->done;
+        }
+
+        for (size_t i = 0; i < m_threads.size(); ++i)
+        {
+            if (returned[i])
+                m_threads[i].join();
+            else
+                m_threads[i].detach();
+        }
+        m_threads.clear();
+        m_members.clear();
+        report.elapsed = Clock::now() - start;
+        return report;
+    }
+};
+
+// A task that keeps doing 2 ms pieces of CPU work until it is stopped
+class BusyTask : public Stoppable {
+public:
+    void run()
+    {
+        while (stopRequested() == false)
+        {
+            auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(2);
+            while (std::chrono::steady_clock::now() < end)
+            {
+            }
+        }
+    }
+};
+
+// A task that needs 'saveTime' to save its state after it is asked to stop
+class SlowToStopTask : public Stoppable {
+    std::chrono::milliseconds saveTime;
+public:
+    explicit SlowToStopTask(std::chrono::milliseconds saveTime) : saveTime(saveTime)
+    {
+    }
+    void run()
+    {
+        waitForStop();
+        std::this_thread::sleep_for(saveTime);
+    }
+};
+
+// Shuts down groups of busy tasks, plus tasks that are slower to stop than the drain deadline,
+// plus tasks that are even slower than the grace time, and checks the report and the shutdown time
+bool testGroupShutdown()
+{
+    const auto drainTime = std::chrono::milliseconds(100);
+    const auto graceTime = std::chrono::milliseconds(200);
+    const auto tolerance = std::chrono::milliseconds(50);
+    const int busyCount = 64;
+    bool passed = true;
+
+    for (int stuckCount : { 0, 4 })
+    {
+        const int slowCount = 8;
+        StoppableGroup group;
+        for (int i = 0; i < busyCount; ++i)
+            group.start(std::unique_ptr<Stoppable>(new BusyTask()));
+        for (int i = 0; i < slowCount; ++i)
+            group.start(std::unique_ptr<Stoppable>(new SlowToStopTask(std::chrono::milliseconds(150))));
+        for (int i = 0; i < stuckCount; ++i)
+            group.start(std::unique_ptr<Stoppable>(new SlowToStopTask(std::chrono::milliseconds(1000))));
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        StoppableGroup::ShutdownReport report = group.shutdown(drainTime, graceTime);
+        bool rejected = !group.start(std::unique_ptr<Stoppable>(new BusyTask()));
+
+        auto limit = stuckCount ? drainTime + graceTime + tolerance : std::chrono::milliseconds(150) + tolerance;
+        bool ok = rejected && report.finished == busyCount && report.timedOut == slowCount && report.abandoned == stuckCount
+            && report.elapsed < limit;
+        passed = passed && ok;
+        std::cout << busyCount + slowCount + stuckCount << " tasks under load : " << report.finished << " finished, "
+                  << report.timedOut << " timed out, " << report.abandoned << " abandoned, shutdown took "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(report.elapsed).count() << " ms -> "
+                  << (ok ? "PASSED" : "FAILED") << std::endl;
+    }
+    return passed;
+}
+
+// Stopping a whole subsystem with one call instead of stopping its tasks one by one
+void cancellingAGroupOfTasks()
+{
+    CancellationScope subsystem;
+    std::vector<std::unique_ptr<MyTask>> tasks;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 3; ++i)
+    {
+        tasks.emplace_back(new MyTask(subsystem.getToken()));
+        MyTask * task = tasks.back().get();
+        threads.emplace_back([task]() {
+            task->run();
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(3));
+
+    std::cout << "Asking Subsystem to Stop" << std::endl;
+    subsystem.cancel();
+
+    for (auto & thread : threads)
+        thread.join();
+    std::cout << "All Threads Joined" << std::endl;
+}
+
+// Cancels a tree of 100 subsystem scopes with 1000 task scopes each.
+// The tree is built by 4 threads at once, and another thread keeps attaching and detaching
+// scopes on the root while it is cancelled.
+void benchmarkScopeCancellation()
+{
+    const int subsystemCount = 100;
+    const int tasksPerSubsystem = 1000;
+    const int builderCount = 4;
+
+    CancellationScope root;
+    std::vector<CancellationScope> subsystems(subsystemCount);
+    std::vector<std::vector<CancellationScope>> tasks(subsystemCount);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> builders;
+    for (int b = 0; b < builderCount; ++b)
+    {
+        builders.emplace_back([&, b]() {
+            for (int i = b; i < subsystemCount; i += builderCount)
+            {
+                subsystems[i] = CancellationScope(root.getToken());
+                tasks[i].reserve(tasksPerSubsystem);
+                for (int j = 0; j < tasksPerSubsystem; ++j)
+                    tasks[i].emplace_back(subsystems[i].getToken());
+            }
+        });
+    }
+    for (auto & builder : builders)
+        builder.join();
+    auto built = std::chrono::steady_clock::now();
+
+    std::atomic<long> churned(0);
+    std::thread churn([&]() {
+        while (!root.cancelled())
+        {
+            CancellationScope temporary(root.getToken());
+            churned++;
+        }
+    });
+    while (churned.load() < 1000)
+        std::this_thread::yield();
+
+    auto cancelStart = std::chrono::steady_clock::now();
+    root.cancel();
+    auto cancelled = std::chrono::steady_clock::now();
+    churn.join();
+
+    long notStopped = 0;
+    for (auto & subsystem : tasks)
+        for (auto & task : subsystem)
+            notStopped += !task.cancelled();
+
+    const long taskCount = long(subsystemCount) * tasksPerSubsystem;
+    double buildMs = std::chrono::duration<double, std::milli>(built - start).count();
+    double cancelMs = std::chrono::duration<double, std::milli>(cancelled - cancelStart).count();
+    std::cout << taskCount << " tasks in " << subsystemCount << " subsystems : built in " << buildMs << " ms, cancelled in "
+              << cancelMs << " ms (" << cancelMs * 1e6 / taskCount << " ns per task), " << churned.load()
+              << " scopes attached / detached meanwhile" << std::endl;
+    if (notStopped)
+        std::cout << "Error : " << notStopped << " tasks were not stopped" << std::endl;
+}
+
+// Rate of adding and cancelling timers, with delays spread over all levels of the wheel
+void benchmarkTimerInsertCancel()
+{
+    const int count = 1000000;
+    TimerWheel timers;
+    std::vector<TimerWheel::TimerId> ids(count);
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> delayMs(1, 3600 * 1000);
+
+    std::vector<std::chrono::milliseconds> delays(count);
+    for (auto & delay : delays)
+        delay = std::chrono::milliseconds(delayMs(random));
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i)
+        ids[i] = timers.scheduleAfter(delays[i], []() {});
+    auto inserted = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i)
+        timers.cancel(ids[i]);
+    auto cancelled = std::chrono::steady_clock::now();
+
+    double insertSeconds = std::chrono::duration<double>(inserted - start).count();
+    double cancelSeconds = std::chrono::duration<double>(cancelled - inserted).count();
+    std::cout << "insert : " << count / insertSeconds / 1e6 << " M timers/s" << std::endl;
+    std::cout << "cancel : " << count / cancelSeconds / 1e6 << " M timers/s" << std::endl;
+}
+
+// How late the timers fire compared to when they were due
+void benchmarkTimerJitter()
+{
+    const int count = 10000;
+    TimerWheel timers;
+    std::vector<std::chrono::steady_clock::time_point> due(count);
+    std::vector<std::chrono::steady_clock::duration> lateness(count);
+    std::atomic<int> firedCount(0);
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> delayMs(1, 2000);
+
+    for (int i = 0; i < count; ++i)
+    {
+        auto delay = std::chrono::milliseconds(delayMs(random));
+        due[i] = std::chrono::steady_clock::now() + delay;
+        timers.scheduleAfter(delay, [&, i]() {
+            lateness[i] = std::chrono::steady_clock::now() - due[i];
+            firedCount.fetch_add(1, std::memory_order_release);
+        });
+    }
+    while (firedCount.load(std::memory_order_acquire) < count)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    std::sort(lateness.begin(), lateness.end());
+    auto us = [&](double fraction) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(lateness[static_cast<size_t>(fraction * (count - 1))]).count();
+    };
+    std::cout << "firing jitter over " << count << " timers : min " << us(0.0) << " us, p50 " << us(0.5)
+              << " us, p99 " << us(0.99) << " us, max " << us(1.0) << " us" << std::endl;
+}
+
+// Thousands of periodic jobs, that would each have needed a sleeping thread, run from the one timer thread
+void benchmarkPeriodicJobs()
+{
+    const int jobs = 10000;
+    TimerWheel timers;
+    std::atomic<long> runs(0);
+    std::vector<TimerWheel::TimerId> ids;
+    for (int i = 0; i < jobs; ++i)
+        ids.push_back(timers.scheduleEvery(std::chrono::milliseconds(100), [&]() {
+            runs.fetch_add(1, std::memory_order_relaxed);
+        }));
+
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+    // The jobs use 'runs', which is gone before 'timers'
+    for (auto id : ids)
+        timers.cancelAndWait(id);
+    std::cout << jobs << " periodic jobs of 100 ms for 2 s on one thread : " << runs.load() << " runs (expected about "
+              << jobs * 20 << ")" << std::endl;
+}
+
+
+// Cost of one stopRequested() check while nobody has asked to stop yet,
+// with a std::future (the old Stoppable) and with a StopToken, from 1 and from 4 polling threads
+template <typename Check>
+double nanosecondsPerCheck(int threadCount, Check check)
+{
+    const long checks = 2000000;
+    std::atomic<long> stopped(0);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t)
+    {
+        threads.emplace_back([&]() {
+            long count = 0;
+            for (long i = 0; i < checks; ++i)
+                count += check();
+            stopped += count;
+        });
+    }
+    for (auto & thread : threads)
+        thread.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (stopped.load() != 0)
+        std::cout << "Error : stop seen without a request" << std::endl;
+    return seconds * 1e9 / (checks * threadCount);
+}
+
+void benchmarkStopRequested()
+{
+    std::promise<void> exitSignal;
+    std::future<void> futureObj = exitSignal.get_future();
+    StopSource stopSource;
+    StopToken token = stopSource.getToken();
+
+    for (int threadCount : { 1, 4 })
+    {
+        double futureNs = nanosecondsPerCheck(threadCount, [&]() {
+            return futureObj.wait_for(std::chrono::milliseconds(0)) != std::future_status::timeout;
+        });
+        double tokenNs = nanosecondsPerCheck(threadCount, [&]() {
+            return token.stopRequested();
+        });
+        std::cout << threadCount << " thread(s) : std::future " << futureNs << " ns per check, StopToken "
+                  << tokenNs << " ns per check" << std::endl;
+    }
+}
+
+
+// taskCount threads block in wait(i) at the same time, then they are released with wake(i) in waves
+// of one task per core : the tasks of a wave are released together, and the next wave starts when they have left.
+// 1000 threads woken at once would wait for each other in the run queue, which measures the scheduler, not the wake up.
+// Returns the sorted latencies from wake(i) to wait(i) returning, 'interrupted' is set if every wait(i) returned true.
+template <typename Wait, typename Wake>
+std::vector<std::chrono::steady_clock::duration> wakeLatencies(int taskCount, Wait wait, Wake wake, bool & interrupted)
+{
+    const int waveSize = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::chrono::steady_clock::time_point> wakeTimes(taskCount);
+    std::vector<std::chrono::steady_clock::time_point> exitTimes(taskCount);
+    std::vector<char> results(taskCount);
+    std::atomic<int> started(0);
+
+    std::vector<std::thread> tasks;
+    for (int i = 0; i < taskCount; ++i)
+    {
+        tasks.emplace_back([&, i]() {
+            started++;
+            results[i] = wait(i);
+            exitTimes[i] = std::chrono::steady_clock::now();
+        });
+    }
+    while (started.load() < taskCount)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    for (int wave = 0; wave < taskCount; wave += waveSize)
+    {
+        int waveEnd = std::min(wave + waveSize, taskCount);
+        for (int i = wave; i < waveEnd; ++i)
+        {
+            wakeTimes[i] = std::chrono::steady_clock::now();
+            wake(i);
+        }
+        // Blocked in join(), the waking thread doesn't compete with the tasks for the cores
+        for (int i = wave; i < waveEnd; ++i)
+            tasks[i].join();
+    }
+
+    std::vector<std::chrono::steady_clock::duration> latencies(taskCount);
+    interrupted = true;
+    for (int i = 0; i < taskCount; ++i)
+    {
+        latencies[i] = exitTimes[i] - wakeTimes[i];
+        interrupted = interrupted && results[i];
+    }
+    std::sort(latencies.begin(), latencies.end());
+    return latencies;
+}
+
+// 1000 tasks are blocked at the same time in a long sleep or in a condition wait of their own that never comes true.
+// Every task must leave its wait interrupted, and the p99 of the time from requestStop() to the task leaving its wait
+// must stay under 1 ms more than the p99 of a plain condition variable notify measured the same way just before.
+// The margin is the time the machine needs to get a woken thread running at all : on an idle machine it is some
+// microseconds, on a loaded machine or under a sanitizer it is milliseconds, and that isn't the stop's doing.
+// Waiting on a std::future is left out, its latency is one slice by design.
+bool testStopLatency()
+{
+    const int taskCount = 1000;
+    const auto limit = std::chrono::milliseconds(1);
+    auto us = [](std::chrono::steady_clock::duration duration) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    };
+
+    // Reference : a flag under a mutex and a condition variable, like the condition waits below without the stop
+    std::vector<std::mutex> mutexes(taskCount);
+    std::vector<std::condition_variable> condVars(taskCount);
+    std::vector<char> flags(taskCount, 0);
+    bool notified;
+    auto reference = wakeLatencies(taskCount, [&](int i) {
+        std::unique_lock<std::mutex> mlock(mutexes[i]);
+        condVars[i].wait(mlock, [&]() { return flags[i] != 0; });
+        return true;
+    }, [&](int i) {
+        {
+            std::lock_guard<std::mutex> guard(mutexes[i]);
+            flags[i] = 1;
+        }
+        condVars[i].notify_one();
+    }, notified);
+    auto margin = reference[taskCount * 99 / 100];
+
+    std::vector<StopSource> stopSources(taskCount);
+    bool interrupted;
+    auto latencies = wakeLatencies(taskCount, [&](int i) {
+        StopToken token = stopSources[i].getToken();
+        bool finished;
+        if (i % 2)
+        {
+            std::unique_lock<std::mutex> mlock(mutexes[i]);
+            finished = waitFor(condVars[i], mlock, token, []() { return false; });
+        }
+        else
+        {
+            finished = sleepFor(std::chrono::hours(1), token);
+        }
+        return !finished;
+    }, [&](int i) {
+        stopSources[i].requestStop();
+    }, interrupted);
+
+    auto p99 = latencies[taskCount * 99 / 100];
+    bool passed = interrupted && p99 < limit + margin;
+    std::cout << "notify latency of " << taskCount << " tasks : p50 " << us(reference[taskCount / 2]) << " us, p99 "
+              << us(margin) << " us, max " << us(reference.back()) << " us" << std::endl;
+    std::cout << "stop to exit latency of " << taskCount << " tasks : p50 " << us(latencies[taskCount / 2]) << " us, p99 "
+              << us(p99) << " us, max " << us(latencies.back()) << " us, limit " << us(limit + margin) << " us -> "
+              << (passed ? "PASSED" : "FAILED") << std::endl;
+    return passed;
+}
+
+
+// Fibers
+// Every Stoppable on a thread of its own costs a kernel thread with its stack, and a kernel context switch
+// every time it sleeps or wakes up, which limits a process to a few thousand tasks.
+// A FiberScheduler runs the tasks as fibers, each with a small stack of its own, on a few worker threads.
+// A fiber runs until it yields: in Stoppable::stopRequested(), sleepFor() and waitForStop().
+// Switching fibers is a user space context switch (ucontext), sleeping fibers cost no thread at all,
+// and a stop request wakes a sleeping fiber through a StopCallback.
+// The stacks come from big slabs of memory, a page only becomes resident when a fiber first touches it.
+// There is no guard page, a fiber must not use more stack than the scheduler gives it
+// (a guard page per stack would need a memory mapping per stack, the kernel allows about 65000).
+// Blocking calls other than these waits (e.g. waitFor on a condition variable) block the whole worker thread.
+class FiberScheduler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+    enum { DefaultStackSize = 32 * 1024 };
+
+private:
+    enum class After { Yield, Sleep, Finish };
+
+    struct Fiber {
+        ucontext_t context;
+        char * stack = nullptr;
+        std::function<void()> body;
+        FiberScheduler * scheduler = nullptr;
+        After after = After::Yield;
+        Clock::time_point wakeAt;
+        unsigned sleepGeneration = 0;
+        int sleeperEntries = 0;         // entries in m_sleepers, the fiber is deleted when the last one is gone
+        bool parked = false;            // sleeping in m_sleepers
+        bool wakeRequested = false;     // stop was requested before the fiber could be parked
+        bool finished = false;
+    };
+
+    struct Sleeper {
+        Clock::time_point wakeAt;
+        Fiber * fiber;
+        unsigned generation;
+        bool operator>(const Sleeper & other) const { return wakeAt > other.wakeAt; }
+    };
+
+    struct Worker {
+        ucontext_t context;
+        Fiber * current = nullptr;
+    };
+
+    enum { StacksPerSlab = 64 };
+
+    const size_t m_stackSize;
+    std::mutex m_mutex;
+    std::condition_variable m_condVar;
+    std::condition_variable m_idle;
+    std::deque<Fiber *> m_ready;
+    std::priority_queue<Sleeper, std::vector<Sleeper>, std::greater<Sleeper>> m_sleepers;
+    std::vector<char *> m_freeStacks;
+    std::vector<char *> m_slabs;
+    size_t m_fiberCount;
+    bool m_done;
+    std::vector<std::thread> m_workers;
+
+    // Not inlined, a fiber that moved to another worker must not see the address of the old worker's slot
+    __attribute__((noinline)) static Worker *& currentWorker()
+    {
+        thread_local Worker * worker = nullptr;
+        return worker;
+    }
+
+    char * allocateStack()
+    {
+        if (m_freeStacks.empty())
+        {
+            size_t slabSize = m_stackSize * StacksPerSlab;
+            void * slab = mmap(nullptr, slabSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (slab == MAP_FAILED)
+                throw std::bad_alloc();
+            m_slabs.push_back(static_cast<char *>(slab));
+            for (int i = 0; i < StacksPerSlab; ++i)
+                m_freeStacks.push_back(static_cast<char *>(slab) + i * m_stackSize);
+        }
+        char * stack = m_freeStacks.back();
+        m_freeStacks.pop_back();
+        return stack;
+    }
+
+    static void entry()
+    {
+        Fiber * fiber = currentWorker()->current;
+        fiber->body();
+        fiber->body = nullptr;
+        fiber->after = After::Finish;
+        switchToWorker(fiber);
+    }
+
+    static void switchToWorker(Fiber * fiber)
+    {
+        swapcontext(&fiber->context, &currentWorker()->context);
+    }
+
+    void releaseFiber(Fiber * fiber)
+    {
+        if (fiber->sleeperEntries == 0)
+            delete fiber;
+    }
+
+    // Called with m_mutex held, after the fiber has left its stack
+    void afterSwitch(Fiber * fiber)
+    {
+        switch (fiber->after)
+        {
+        case After::Yield:
+            m_ready.push_back(fiber);
+            break;
+        case After::Sleep:
+            if (fiber->wakeRequested)
+            {
+                fiber->wakeRequested = false;
+                m_ready.push_back(fiber);
+            }
+            else
+            {
+                fiber->parked = true;
+                fiber->sleeperEntries++;
+                m_sleepers.push({ fiber->wakeAt, fiber, fiber->sleepGeneration });
+            }
+            break;
+        case After::Finish:
+            m_freeStacks.push_back(fiber->stack);
+            fiber->finished = true;
+            releaseFiber(fiber);
+            if (--m_fiberCount == 0)
+                m_idle.notify_all();
+            break;
+        }
+    }
+
+    // Called with m_mutex held
+    void wakeSleepers(Clock::time_point now)
+    {
+        while (!m_sleepers.empty() && m_sleepers.top().wakeAt <= now)
+        {
+            Sleeper sleeper = m_sleepers.top();
+            m_sleepers.pop();
+            Fiber * fiber = sleeper.fiber;
+            fiber->sleeperEntries--;
+            if (fiber->finished)
+                releaseFiber(fiber);
+            else if (fiber->parked && fiber->sleepGeneration == sleeper.generation)
+            {
+                fiber->parked = false;
+                fiber->sleepGeneration++;
+                m_ready.push_back(fiber);
+            }
+        }
+    }
+
+    // A stop request for a sleeping fiber, from any thread
+    void wake(Fiber * fiber)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (fiber->parked)
+        {
+            fiber->parked = false;
+            fiber->sleepGeneration++;
+            m_ready.push_back(fiber);
+            m_condVar.notify_one();
+        }
+        else
+        {
+            fiber->wakeRequested = true;
+        }
+    }
+
+    void workerLoop()
+    {
+        Worker worker;
+        currentWorker() = &worker;
+        std::unique_lock<std::mutex> mlock(m_mutex);
+        while (true)
+        {
+            wakeSleepers(Clock::now());
+            if (!m_ready.empty())
+            {
+                Fiber * fiber = m_ready.front();
+                m_ready.pop_front();
+                if (!m_ready.empty())
+                    m_condVar.notify_one();
+                mlock.unlock();
+                worker.current = fiber;
+                swapcontext(&worker.context, &fiber->context);
+                worker.current = nullptr;
+                mlock.lock();
+                afterSwitch(fiber);
+                continue;
+            }
+            if (m_done && m_fiberCount == 0)
+                break;
+            if (m_sleepers.empty())
+            {
+                m_condVar.wait(mlock);
+            }
+            else
+            {
+                // A copy, the heap may change while we wait
+                Clock::time_point wakeAt = m_sleepers.top().wakeAt;
+                m_condVar.wait_until(mlock, wakeAt);
+            }
+        }
+        currentWorker() = nullptr;
+    }
+
+public:
+    explicit FiberScheduler(unsigned workerCount = std::thread::hardware_concurrency(), size_t stackSize = DefaultStackSize)
+        : m_stackSize(stackSize), m_fiberCount(0), m_done(false)
+    {
+        for (unsigned i = 0; i < std::max(1u, workerCount); ++i)
+            m_workers.emplace_back(&FiberScheduler::workerLoop, this);
+    }
+
+    FiberScheduler(const FiberScheduler &) = delete;
+    FiberScheduler & operator=(const FiberScheduler &) = delete;
+
+    // Waits for all fibers to finish
+    ~FiberScheduler()
+    {
+        waitUntilIdle();
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_done = true;
+        }
+        m_condVar.notify_all();
+        for (auto & worker : m_workers)
+            worker.join();
+        while (!m_sleepers.empty())
+        {
+            m_sleepers.top().fiber->sleeperEntries--;
+            releaseFiber(m_sleepers.top().fiber);
+            m_sleepers.pop();
+        }
+        for (char * slab : m_slabs)
+            munmap(slab, m_stackSize * StacksPerSlab);
+    }
+
+    void spawn(std::function<void()> body)
+    {
+        Fiber * fiber = new Fiber();
+        fiber->body = std::move(body);
+        fiber->scheduler = this;
+        std::lock_guard<std::mutex> guard(m_mutex);
+        fiber->stack = allocateStack();
+        getcontext(&fiber->context);
+        fiber->context.uc_stack.ss_sp = fiber->stack;
+        fiber->context.uc_stack.ss_size = m_stackSize;
+        fiber->context.uc_link = nullptr;
+        makecontext(&fiber->context, &FiberScheduler::entry, 0);
+        m_fiberCount++;
+        m_ready.push_back(fiber);
+        m_condVar.notify_one();
+    }
+
+    // Runs task.run() as a fiber, the task must live until it returns
+    void spawn(Stoppable & task)
+    {
+        spawn([&task]() { task.run(); });
+    }
+
+    void waitUntilIdle()
+    {
+        std::unique_lock<std::mutex> mlock(m_mutex);
+        m_idle.wait(mlock, [this]() { return m_fiberCount == 0; });
+    }
+
+    static bool inFiber()
+    {
+        Worker * worker = currentWorker();
+        return worker && worker->current;
+    }
+
+    // Lets the other fibers run, the fiber goes to the end of the ready queue
+    static void yield()
+    {
+        Fiber * fiber = currentWorker()->current;
+        fiber->after = After::Yield;
+        switchToWorker(fiber);
+    }
+
+    // Returns false if the sleep was ended by the stop request
+    static bool sleepFor(Clock::duration duration, const StopToken & token)
+    {
+        Fiber * fiber = currentWorker()->current;
+        if (token.stopRequested())
+            return false;
+        {
+            std::lock_guard<std::mutex> guard(fiber->scheduler->m_mutex);
+            fiber->wakeRequested = false;
+        }
+        auto onStop = makeStopCallback(token, [fiber]() { fiber->scheduler->wake(fiber); });
+        fiber->wakeAt = Clock::now() + duration;
+        fiber->after = After::Sleep;
+        switchToWorker(fiber);
+        return !token.stopRequested();
+    }
+};
+
+bool inFiber()
+{
+    return FiberScheduler::inFiber();
+}
+
+void yieldFiber()
+{
+    FiberScheduler::yield();
+}
+
+bool sleepFiber(std::chrono::steady_clock::duration duration, const StopToken & token)
+{
+    return FiberScheduler::sleepFor(duration, token);
+}
+
+// Resident memory of the process
+long residentMemoryKb()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, 6, "VmRSS:") == 0)
+            return std::atol(line.c_str() + 6);
+    }
+    return 0;
+}
+
+// A MyTask style loop : a bit of work every 1 second until it is stopped
+class PeriodicTask : public Stoppable {
+    std::atomic<long> & iterations;
+public:
+    PeriodicTask(const StopToken & parent, std::atomic<long> & iterations) : Stoppable(parent), iterations(iterations)
+    {
+    }
+    void run()
+    {
+        while (stopRequested() == false)
+        {
+            iterations.fetch_add(1, std::memory_order_relaxed);
+            sleepFor(std::chrono::milliseconds(1000), getStopToken());
+        }
+    }
+};
+
+// Memory per task, and the time to stop all of them, with 'taskCount' PeriodicTasks
+// on fibers or on a thread each
+void measureTasks(int taskCount, bool useFibers)
+{
+    CancellationScope root;
+    std::atomic<long> iterations(0);
+    std::vector<std::unique_ptr<PeriodicTask>> tasks;
+    for (int i = 0; i < taskCount; ++i)
+        tasks.emplace_back(new PeriodicTask(root.getToken(), iterations));
+
+    long memoryBefore = residentMemoryKb();
+    std::unique_ptr<FiberScheduler> scheduler;
+    std::vector<std::thread> threads;
+    if (useFibers)
+    {
+        scheduler.reset(new FiberScheduler());
+        for (auto & task : tasks)
+            scheduler->spawn(*task);
+    }
+    else
+    {
+        for (auto & task : tasks)
+        {
+            PeriodicTask * taskPtr = task.get();
+            threads.emplace_back([taskPtr]() { taskPtr->run(); });
+        }
+    }
+    while (iterations.load() < taskCount)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    long memoryAfter = residentMemoryKb();
+
+    auto start = std::chrono::steady_clock::now();
+    root.cancel();
+    if (useFibers)
+        scheduler->waitUntilIdle();
+    for (auto & thread : threads)
+        thread.join();
+    double stopMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << taskCount << (useFibers ? " fibers  : " : " threads : ") << (memoryAfter - memoryBefore) * 1024.0 / taskCount
+              << " bytes resident per task, all stopped in " << stopMs << " ms" << std::endl;
+}
+
+// Two fibers on one worker yield to each other, two threads hand a turn back and forth with a condition variable
+void measureSwitchLatency()
+{
+    const long switches = 1000000;
+    {
+        FiberScheduler scheduler(1);
+        auto start = std::chrono::steady_clock::now();
+        for (int f = 0; f < 2; ++f)
+        {
+            scheduler.spawn([]() {
+                for (long i = 0; i < switches / 2; ++i)
+                    FiberScheduler::yield();
+            });
+        }
+        scheduler.waitUntilIdle();
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / switches;
+        std::cout << "fiber switch  : " << ns << " ns" << std::endl;
+    }
+    {
+        const long handOffs = switches / 10;
+        std::mutex mutex;
+        std::condition_variable condVar;
+        long turn = 0;
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 2; ++t)
+        {
+            threads.emplace_back([&, t]() {
+                std::unique_lock<std::mutex> mlock(mutex);
+                for (long i = 0; i < handOffs / 2; ++i)
+                {
+                    condVar.wait(mlock, [&]() { return turn % 2 == t; });
+                    turn++;
+                    condVar.notify_one();
+                }
+            });
+        }
+        for (auto & thread : threads)
+            thread.join();
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / handOffs;
+        std::cout << "thread switch : " << ns << " ns" << std::endl;
+    }
+}
+
+void benchmarkFibers()
+{
+    measureSwitchLatency();
+    measureTasks(10000, false);
+    measureTasks(10000, true);
+    measureTasks(100000, true);
+}
+
+
 int main(int   argc,
     char *argv[])
 {
     //stoppingThreadUsingFuture();
+    //benchmarkTimerInsertCancel();
+    //benchmarkTimerJitter();
+    //benchmarkPeriodicJobs();
+    //benchmarkStopRequested();
+    //testStopLatency();
+    //cancellingAGroupOfTasks();
+    //benchmarkScopeCancellation();
+    //testGroupShutdown();
+    //benchmarkFibers();
     
     creatingAStoppableTask();
     return 0;